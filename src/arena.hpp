@@ -0,0 +1,276 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  arena.hpp
+ *
+ *    Description:  Per-thread bump allocators for per-frame temporaries
+ *
+ *        Version:  1.0
+ *        Created:  22.10.2026 10:05:37
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+#include <omp.h>
+
+// Bump allocator. Allocation is a pointer increment, freeing is a no-op
+// except for the most recent allocation, and reset() drops everything.
+// When a block runs out a new one is chained, on the next reset the
+// blocks are merged so a steady frame lives in one block.
+class FrameArena
+{
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t block = 0;       // current block
+    size_t offset = 0;      // into the current block
+    size_t used = 0;        // bytes handed out, padding included
+    size_t peak = 0;
+
+public:
+    struct Mark
+    {
+        size_t block, offset, used;
+    };
+
+    FrameArena(size_t block_size = 1 << 20)
+    {
+        blocks.push_back(Block({std::make_unique<char[]>(block_size), block_size}));
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t bytes, size_t align)
+    {
+        while(true) {
+            Block &b = blocks[block];
+            size_t start = (offset + align - 1) & ~(align - 1);
+            if(start + bytes <= b.size) {
+                used += start + bytes - offset;
+                offset = start + bytes;
+                peak = std::max(peak, used);
+                return b.data.get() + start;
+            }
+
+            used += b.size - offset;
+            if(++block == blocks.size()) {
+                size_t size = std::max(b.size * 2, bytes + align);
+                blocks.push_back(Block({std::make_unique<char[]>(size), size}));
+            }
+            offset = 0;
+        }
+    }
+
+    // Gives the memory back only if it was the last allocation
+    void deallocate(void *ptr, size_t bytes)
+    {
+        char *p = static_cast<char*>(ptr);
+        if(p + bytes == blocks[block].data.get() + offset) {
+            offset -= bytes;
+            used -= bytes;
+        }
+    }
+
+    Mark mark() const { return Mark({block, offset, used}); }
+
+    // Frees everything allocated after `m`
+    void rewind(const Mark &m)
+    {
+        block = m.block;
+        offset = m.offset;
+        used = m.used;
+    }
+
+    void reset()
+    {
+        if(blocks.size() > 1) {
+            size_t total = 0;
+            for(auto &b : blocks) total += b.size;
+            blocks.clear();
+            blocks.push_back(Block({std::make_unique<char[]>(total), total}));
+        }
+        block = 0;
+        offset = 0;
+        used = 0;
+    }
+
+    size_t getUsed() const { return used; }
+    size_t getPeak() const { return peak; }
+    void resetPeak() { peak = used; }
+
+    size_t getCapacity() const
+    {
+        size_t total = 0;
+        for(auto &b : blocks) total += b.size;
+        return total;
+    }
+};
+
+// The arena allocations of the calling thread go to, null for the heap
+inline thread_local FrameArena *current_arena = nullptr;
+
+// Routes the allocations of this thread into `arena` for its lifetime
+class ArenaScope
+{
+    FrameArena *prev;
+public:
+    ArenaScope(FrameArena *arena) : prev(current_arena) { current_arena = arena; }
+    ~ArenaScope() { current_arena = prev; }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+// Frees everything the current arena handed out during its lifetime.
+// Objects allocated after it must be gone before it is destroyed.
+class ArenaMark
+{
+    FrameArena *arena;
+    FrameArena::Mark m = { 0, 0, 0 };
+public:
+    ArenaMark() : arena(current_arena)
+    {
+        if(arena) m = arena->mark();
+    }
+    ~ArenaMark()
+    {
+        if(arena) arena->rewind(m);
+    }
+
+    ArenaMark(const ArenaMark&) = delete;
+    ArenaMark& operator=(const ArenaMark&) = delete;
+};
+
+// Standard allocator over the arena that is current when it is created,
+// or the heap if there is none. Copies of a container pick the arena of
+// the thread that copies, so values passed between threads or out of a
+// frame can be copied into a longer lived context.
+//
+// Memory from an arena is only valid until that arena is reset, do not
+// build long lived containers (models, caches) while a scope is active.
+template<typename T>
+class FrameAllocator
+{
+    FrameArena *arena;
+
+    template<typename U> friend class FrameAllocator;
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::false_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    FrameAllocator() noexcept : arena(current_arena) { }
+    FrameAllocator(FrameArena *arena) noexcept : arena(arena) { }
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U> &other) noexcept : arena(other.arena) { }
+
+    T* allocate(size_t n)
+    {
+        if(!arena) return std::allocator<T>().allocate(n);
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        if(!arena) {
+            std::allocator<T>().deallocate(p, n);
+        } else {
+            arena->deallocate(p, n * sizeof(T));
+        }
+    }
+
+    FrameAllocator select_on_container_copy_construction() const
+    {
+        return FrameAllocator();
+    }
+
+    FrameArena* getArena() const { return arena; }
+
+    template<typename U>
+    bool operator==(const FrameAllocator<U> &other) const { return arena == other.arena; }
+    template<typename U>
+    bool operator!=(const FrameAllocator<U> &other) const { return arena != other.arena; }
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+struct FrameArenaStats
+{
+    size_t peak;            // sum of the per-thread peaks
+    size_t max_thread_peak;
+    size_t capacity;        // reserved by all arenas
+};
+
+// One arena per OpenMP thread. Bind the arena of each rendering thread
+// with ArenaScope(arenas.local()) and call endFrame() once the frame is
+// done and no arena memory is referenced any more.
+class FrameArenas
+{
+    std::vector<std::unique_ptr<FrameArena>> arenas;
+    std::function<void(const FrameArenaStats&)> peak_hook;
+
+public:
+    FrameArenas(int num_threads = omp_get_max_threads(), size_t block_size = 1 << 20)
+    {
+        for(int i = 0; i < num_threads; i++) {
+            arenas.push_back(std::make_unique<FrameArena>(block_size));
+        }
+    }
+
+    // Arena of the calling OpenMP thread
+    FrameArena* local()
+    {
+        return arenas[omp_get_thread_num() % arenas.size()].get();
+    }
+
+    // Called by endFrame() with the usage of the frame
+    void setPeakHook(std::function<void(const FrameArenaStats&)> hook)
+    {
+        peak_hook = hook;
+    }
+
+    FrameArenaStats stats() const
+    {
+        FrameArenaStats s = { 0, 0, 0 };
+        for(auto &a : arenas) {
+            s.peak += a->getPeak();
+            s.max_thread_peak = std::max(s.max_thread_peak, a->getPeak());
+            s.capacity += a->getCapacity();
+        }
+        return s;
+    }
+
+    void endFrame()
+    {
+        if(peak_hook) peak_hook(stats());
+        for(auto &a : arenas) {
+            a->reset();
+            a->resetPeak();
+        }
+    }
+};
+
+#endif
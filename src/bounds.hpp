@@ -0,0 +1,145 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  bounds.hpp
+ *
+ *    Description:  Bounding boxes and view frustum tests
+ *
+ *        Version:  1.0
+ *        Created:  23.10.2026 14:05:51
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include <array>
+#include <limits>
+#include <algorithm>
+
+#include "math/vector.hpp"
+#include "math/matrix.hpp"
+
+using tmath::Vec3;
+using tmath::Vec4;
+using tmath::Mat4;
+
+struct AABB
+{
+    // Empty until something is added
+    Vec3 lo;
+    Vec3 hi;
+
+    AABB()
+    {
+        float inf = std::numeric_limits<float>::max();
+        lo = Vec3({inf, inf, inf});
+        hi = Vec3({-inf, -inf, -inf});
+    }
+
+    bool empty() const { return lo[0] > hi[0]; }
+
+    void extend(const Vec3 &p)
+    {
+        for(int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], p[c]);
+            hi[c] = std::max(hi[c], p[c]);
+        }
+    }
+
+    void extend(const AABB &box)
+    {
+        if(box.empty()) return;
+        extend(box.lo);
+        extend(box.hi);
+    }
+
+    Vec3 center() const { return (lo + hi) * 0.5f; }
+
+    float area() const
+    {
+        if(empty()) return 0.0f;
+        Vec3 d = hi - lo;
+        return 2.0f * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+    }
+
+    Vec3 corner(int i) const
+    {
+        return Vec3({ i & 1 ? hi[0] : lo[0], i & 2 ? hi[1] : lo[1], i & 4 ? hi[2] : lo[2] });
+    }
+
+    // Box around the transformed corners
+    AABB transformed(const Mat4 &m) const
+    {
+        AABB res;
+        if(empty()) return res;
+        for(int i = 0; i < 8; i++) {
+            res.extend(tmath::toVec3(m * tmath::toVec4(corner(i), 1.0f)));
+        }
+        return res;
+    }
+};
+
+enum class Containment
+{
+    Outside,
+    Intersects,
+    Inside
+};
+
+// The six clip planes of a projection, in the space the matrix maps from
+class Frustum
+{
+    // Inside where dot(plane.xyz, p) + plane.w >= 0
+    std::array<Vec4, 6> planes;
+
+public:
+    Frustum(const Mat4 &to_clip)
+    {
+        // Gribb and Hartmann: rows of the matrix combined
+        for(int i = 0; i < 3; i++) {
+            for(int s = 0; s < 2; s++) {
+                float sign = s ? -1.0f : 1.0f;
+                Vec4 plane;
+                for(int j = 0; j < 4; j++) {
+                    plane[j] = to_clip(3, j) + sign * to_clip(i, j);
+                }
+                float len = tmath::length(tmath::toVec3(plane));
+                planes[i * 2 + s] = len > 0.0f ? plane / len : plane;
+            }
+        }
+    }
+
+    bool outside(const Vec3 &center, float radius) const
+    {
+        for(const Vec4 &p : planes) {
+            if(tmath::dot(tmath::toVec3(p), center) + p[3] < -radius) return true;
+        }
+        return false;
+    }
+
+    Containment classify(const AABB &box) const
+    {
+        if(box.empty()) return Containment::Outside;
+        Containment res = Containment::Inside;
+        for(const Vec4 &p : planes) {
+            // Nearest and farthest corners along the plane normal
+            Vec3 nearest, farthest;
+            for(int c = 0; c < 3; c++) {
+                nearest[c] = p[c] >= 0.0f ? box.lo[c] : box.hi[c];
+                farthest[c] = p[c] >= 0.0f ? box.hi[c] : box.lo[c];
+            }
+            if(tmath::dot(tmath::toVec3(p), farthest) + p[3] < 0.0f) return Containment::Outside;
+            if(tmath::dot(tmath::toVec3(p), nearest) + p[3] < 0.0f) res = Containment::Intersects;
+        }
+        return res;
+    }
+};
+
+#endif
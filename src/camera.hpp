@@ -0,0 +1,95 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  camera.hpp
+ *
+ *    Description:  Pinhole camera shared by the rasterizer and the ray marcher
+ *
+ *        Version:  1.0
+ *        Created:  24.10.2026 10:02:36
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef CAMERA_HPP
+#define CAMERA_HPP
+
+#include <cmath>
+
+#include "math/vector.hpp"
+#include "math/matrix.hpp"
+#include "math/transform.hpp"
+#include "math/quaternion.hpp"
+
+using tmath::Vec3;
+using tmath::Vec4;
+using tmath::Mat4;
+using tmath::Quat;
+
+// Looks along rot * +z with rot * +x to the right of the image and
+// rot * +y up, like trace() and look_at. view() and projection() give the
+// matrices for the rasterizer, ray() the matching ray through a pixel, so
+// both produce the same image and their depths can be compared.
+struct Camera
+{
+    Vec3 pos;
+    Quat rot;
+    float fov = 3.1415f / 4;    // vertical, as in perspective()
+    float near = 0.01f;
+    float far = 100.0f;
+
+    Vec3 right() const { return tmath::rotate(Vec3({1,0,0}), rot); }
+    Vec3 up() const { return tmath::rotate(Vec3({0,1,0}), rot); }
+    Vec3 forward() const { return tmath::rotate(Vec3({0,0,1}), rot); }
+
+    // World to the camera space of perspective(), which looks down -z
+    Mat4 view() const
+    {
+        Vec3 axes[3] = { right(), up(), -1.0f * forward() };
+        Mat4 m;
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 3; j++) m(i, j) = axes[i][j];
+            m(i, 3) = -tmath::dot(axes[i], pos);
+        }
+        m(3, 3) = 1.0f;
+        return m;
+    }
+
+    Mat4 projection(float aspect) const
+    {
+        return tmath::perspective(fov, aspect, near, far);
+    }
+
+    // Unnormalized direction through the centre of pixel (x, y), its
+    // component along forward() is 1
+    Vec3 ray(int x, int y, int width, int height) const
+    {
+        float t = std::tan(fov / 2.0f);
+        float u = (2.0f * (x + 0.5f) / width - 1.0f) * t * width / height;
+        float v = (1.0f - 2.0f * (y + 0.5f) / height) * t;
+        return right() * u + up() * v + forward();
+    }
+
+    // NDC depth of perspective() to the distance along the camera axis
+    // and back
+    float viewDepth(float ndc_depth) const
+    {
+        float a = (far + near) / (far - near);
+        float b = 2.0f * far * near / (far - near);
+        return b / (a - ndc_depth);
+    }
+
+    float ndcDepth(float view_depth) const
+    {
+        float a = (far + near) / (far - near);
+        float b = 2.0f * far * near / (far - near);
+        return a - b / view_depth;
+    }
+};
+
+#endif
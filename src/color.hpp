@@ -21,10 +21,13 @@
 
 #include <vector>
 #include <cmath>
+#include <algorithm>
 #include <variant>
 
 #include "math/vector.hpp"
 
+using uchar = unsigned char;
+
 enum RGBAChannels {
     R = 0,
     G = 1,
@@ -58,4 +61,72 @@ RGBAColor rgb2rgba(const RGBColor &rgb, float alpha = 1.0f);
 
 /* Blending */
 
+enum class BlendMode
+{
+    Replace,        // src
+    Alpha,          // over: src * src.a + dst * (1 - src.a)
+    Premultiplied,  // over with premultiplied src: src + dst * (1 - src.a)
+    Additive,       // src + dst
+    WeightedOIT     // into the framebuffer's OIT buffers, see setOIT
+};
+
+// Blends `n` RGBA float pixels of `src` into `dst`. The alpha channel is
+// blended like the others. A transparent black src leaves dst as it is.
+template<BlendMode MODE>
+inline void blend_span(const float *src, float *dst, int n)
+{
+    static_assert(MODE != BlendMode::WeightedOIT, "OIT accumulates, see oit_accumulate_span");
+    #pragma omp simd
+    for(int i = 0; i < n; i++) {
+        float a = src[i*4 + A];
+        for(int c = 0; c < 4; c++) {
+            float s = src[i*4 + c], d = dst[i*4 + c];
+            if constexpr(MODE == BlendMode::Replace) dst[i*4 + c] = s;
+            else if constexpr(MODE == BlendMode::Alpha) dst[i*4 + c] = s * a + d * (1.0f - a);
+            else if constexpr(MODE == BlendMode::Premultiplied) dst[i*4 + c] = s + d * (1.0f - a);
+            else dst[i*4 + c] = s + d;
+        }
+    }
+}
+
+// Weighted blended order independent transparency (McGuire, Bavoil
+// 2013). Every fragment adds its premultiplied colour times a weight
+// that falls with depth, and the product of (1 - alpha) is kept as the
+// revealage. Weight of eq. 10 for NDC depth z.
+inline float oit_weight(float z, float alpha)
+{
+    float d = 1.0f - (z + 1.0f) * 0.5f;
+    return alpha * std::max(1e-2f, 3e3f * d * d * d);
+}
+
+// `n` fragments of straight alpha colours `src` at NDC depths `depth`
+inline void oit_accumulate_span(const float *src, const float *depth, float *accum,
+                                float *revealage, int n)
+{
+    #pragma omp simd
+    for(int i = 0; i < n; i++) {
+        float a = src[i*4 + A];
+        float w = oit_weight(depth[i], a);
+        for(int c = 0; c < 3; c++) {
+            accum[i*4 + c] += src[i*4 + c] * w;
+        }
+        accum[i*4 + A] += w;
+        revealage[i] *= 1.0f - a;
+    }
+}
+
+// Weighted average colour over `dst` with alpha 1 - revealage
+inline void oit_composite_span(const float *accum, const float *revealage, float *dst, int n)
+{
+    #pragma omp simd
+    for(int i = 0; i < n; i++) {
+        float a = 1.0f - revealage[i];
+        float inv_w = 1.0f / std::max(accum[i*4 + A], 1e-5f);
+        for(int c = 0; c < 3; c++) {
+            dst[i*4 + c] = accum[i*4 + c] * inv_w * a + dst[i*4 + c] * (1.0f - a);
+        }
+        dst[i*4 + A] = a + dst[i*4 + A] * (1.0f - a);
+    }
+}
+
 #endif
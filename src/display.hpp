@@ -23,18 +23,25 @@
 #include "rasterizer.hpp"
 #include "framebuffer.hpp"
 #include "image.hpp"
-class Display
+#include "present.hpp"
+
+// Window output. Either draw into getFBO() and call Update(), or use it
+// as the backend of a Presenter (upload and present stay on the calling
+// thread, as SDL requires).
+class Display : public PresentBackend
 {
     SDL_Window *win = NULL;
     SDL_Renderer *renderer = NULL;
     SDL_Texture *tex = NULL;
 
     Framebuffer fbo;
+    std::vector<uchar> staging;
     int win_width;
     int win_height;
 public:
-    Display(unsigned width, unsigned height, const std::string &window_title) :
-        win_width(width), win_height(height), fbo(width, height)
+    Display(unsigned width, unsigned height, const std::string &window_title,
+            PixelFormat format = PixelFormat::RGBA8_SRGB) :
+        win_width(width), win_height(height), fbo(width, height, format)
     {
         //SDL_Init(SDL_INIT_EVERYTHING);
         SDL_Init(SDL_INIT_EVERYTHING);
@@ -50,7 +57,7 @@ public:
         renderer = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
         tex = SDL_CreateTexture(
                 renderer,
-                SDL_PIXELFORMAT_RGB24,
+                SDL_PIXELFORMAT_RGBA32,
                 SDL_TEXTUREACCESS_STREAMING,
                 width,
                 height
@@ -63,17 +70,68 @@ public:
         SDL_Quit();
     }
 
+    // Converts and uploads only the tiles written since the last update,
+    // the texture keeps the rest
     void Update()
     {
-        SRGBImage rgb = image_a2s(fbo.getImage());
-        const uchar* pixels = rgb.getRawData();
+        auto &image = fbo.getImage();
+        bool direct = image.getFormat() == PixelFormat::RGBA8_SRGB;
+        if(!direct) {
+            staging.resize(size_t(win_width) * win_height * 4);
+        }
+
+        for(const TileRect &r : fbo.takeDirtyRects()) {
+            size_t offset = (size_t(r.y0) * win_width + r.x0) * 4;
+            if(direct) {
+                // Already in the texture format, no conversion pass
+                uploadRect(r, image.getRawData() + offset, 4 * win_width);
+            } else {
+                image.encodeRect(r.y0, r.x0, r.y1, r.x1, staging.data() + offset,
+                                 4 * win_width, 4, Dither::Ordered);
+                uploadRect(r, staging.data() + offset, 4 * win_width);
+            }
+        }
+        show();
+    }
+
+    void present(const uchar *pixels, int pitch) override
+    {
+        SDL_UpdateTexture(tex, NULL, pixels, pitch);
+        show();
+    }
+
+    void presentRects(const uchar *pixels, int pitch, const std::vector<TileRect> &rects) override
+    {
+        for(const TileRect &r : rects) {
+            uploadRect(r, pixels + size_t(r.y0) * pitch + size_t(r.x0) * 4, pitch);
+        }
+        show();
+    }
+
+    bool pollQuit() override
+    {
+        SDL_Event e;
+        while(SDL_PollEvent(&e)) {
+            if(e.type == SDL_QUIT) return true;
+        }
+        return false;
+    }
+
+    Framebuffer& getFBO() { return fbo; }
+
+private:
+    void uploadRect(const TileRect &r, const uchar *pixels, int pitch)
+    {
+        SDL_Rect rect = { r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0 };
+        SDL_UpdateTexture(tex, &rect, pixels, pitch);
+    }
+
+    void show()
+    {
         SDL_RenderClear(renderer);
-        SDL_UpdateTexture(tex, NULL, pixels, 3 * win_width);
         SDL_RenderCopy(renderer, tex, NULL, NULL);
         SDL_RenderPresent(renderer);
         //SDL_UpdateWindowSurface(win);
     }
-
-    Framebuffer& getFBO() { return fbo; }
 };
 
@@ -4,24 +4,317 @@
 #include "model.hpp"
 #include "shader.hpp"
 #include "rasterizer.hpp"
+#include "meshlet.hpp"
 
+struct DrawStats
+{
+    size_t triangles = 0;
+    size_t culled = 0;
 
+    float culledPercent() const
+    {
+        return triangles ? 100.0f * culled / triangles : 0.0f;
+    }
+};
 
+// State is a PipelineState, by default the one the framebuffer's flags
+// select, e.g. draw_model<DepthOnlyPipeline>(...) for a depth prepass
+template<typename State = FramebufferPipeline>
 void draw_model(const Model &model, Shader shader, Framebuffer &fbo, const UniformVec &uni)
 {
     PartialFSH fsh = apply_fsh_uniform(shader.frag, uni);
     PartialVSH vsh = apply_vsh_uniform(shader.vert, uni);
     
-    std::vector<Vertex> vertices(model.v_attrs.size());
+    const VertexBuffer &vb = model.vertices;
+    FrameVector<Vertex> vertices(vb.size());
+
+    // One pass over the interleaved buffer, the decoded attributes reuse
+    // the same storage for every vertex
+    AttribVec attrs;
+    for(size_t i = 0; i < vb.size(); i++) {
+        vb.decode(i, attrs);
+        vertices[i] = vsh(attrs);
+    }
+
+    const IndexBuffer &ib = model.indices;
+    for(size_t t = 0; t < ib.numTriangles(); t++) {
+        Triangle tri = std::forward_as_tuple(vertices[ib[3*t]], vertices[ib[3*t+1]],
+                                             vertices[ib[3*t+2]]);
+        rasterize_triangle<State>(tri, fsh, fbo);
+    }
+}
+
+// Skips whole meshlets that `culler` rejects before any of their vertices
+// are shaded. Models without meshlets are drawn in full.
+template<typename State = FramebufferPipeline>
+DrawStats draw_model(const Model &model, Shader shader, Framebuffer &fbo,
+                     const UniformVec &uni, const ClusterCuller &culler)
+{
+    DrawStats stats;
+    stats.triangles = model.indices.numTriangles();
+    if(model.meshlets.empty()) {
+        draw_model<State>(model, shader, fbo, uni);
+        return stats;
+    }
+
+    PartialFSH fsh = apply_fsh_uniform(shader.frag, uni);
+    PartialVSH vsh = apply_vsh_uniform(shader.vert, uni);
+
+    const VertexBuffer &vb = model.vertices;
+    const IndexBuffer &ib = model.indices;
+    FrameVector<Vertex> vertices(vb.size());
+    FrameVector<uint8_t> shaded(vb.size(), 0);
+    AttribVec attrs;
+
+    for(const Meshlet &m : model.meshlets) {
+        if(culler.cull(m)) {
+            stats.culled += m.num_triangles;
+            continue;
+        }
+        size_t t1 = m.first_triangle + m.num_triangles;
+        for(size_t i = m.first_triangle * 3; i < t1 * 3; i++) {
+            uint32_t v = ib[i];
+            if(shaded[v]) continue;
+            vb.decode(v, attrs);
+            vertices[v] = vsh(attrs);
+            shaded[v] = 1;
+        }
+        for(size_t t = m.first_triangle; t < t1; t++) {
+            Triangle tri = std::forward_as_tuple(vertices[ib[3*t]], vertices[ib[3*t+1]],
+                                                 vertices[ib[3*t+2]]);
+            rasterize_triangle<State>(tri, fsh, fbo);
+        }
+    }
+    return stats;
+}
+
+struct DrawCall
+{
+    const Model *model;
+    Shader shader;
+    UniformVec uniforms;
+};
+
+// Shades every visible pixel once whatever the order of `calls`: the
+// depth of all of them goes first, then they are drawn again with an
+// equal depth test. The vertex shader must give the same positions both
+// times. Depth is tested whatever the framebuffer's flag says.
+inline void draw_prepassed(const std::vector<DrawCall> &calls, Framebuffer &fbo)
+{
+    for(const DrawCall &call : calls) {
+        draw_model<DepthOnlyPipeline>(*call.model, call.shader, fbo, call.uniforms);
+    }
+    for(const DrawCall &call : calls) {
+        draw_model<EqualDepthPipeline>(*call.model, call.shader, fbo, call.uniforms);
+    }
+}
+
+// Draws the model once per element of `instances`. The attributes of an
+// instance (a transform as Vec4 rows, a colour, ...) follow the vertex
+// attributes in the shader input. Shader binding and vertex decoding are
+// done once for the whole batch.
+//
+// All instances are shaded first, in parallel. Their triangles are then
+// binned per strip of framebuffer tiles (full width, one tile high) in
+// draw order, and the strips are rasterized in parallel. Strips rather
+// than tiles, since the scanline rasterizer's setup is per row and a
+// tile split would repeat it for every tile a row crosses. Each strip sees
+// its triangles in the order of N draw_model calls, so blending gives the
+// same result. The shaded vertices of every instance are kept until the
+// call returns.
+template<typename State = FramebufferPipeline>
+void draw_model_instanced(const Model &model, const VertexBuffer &instances,
+                          Shader shader, Framebuffer &fbo, const UniformVec &uni)
+{
+    if constexpr(std::is_same_v<State, FramebufferPipeline>) {
+        if(fbo.depthEnabled()) {
+            draw_model_instanced<OpaquePipeline>(model, instances, shader, fbo, uni);
+        } else {
+            draw_model_instanced<NoDepthPipeline>(model, instances, shader, fbo, uni);
+        }
+    } else {
+        PartialFSH fsh = apply_fsh_uniform(shader.frag, uni);
+        PartialVSH vsh = apply_vsh_uniform(shader.vert, uni);
+
+        const VertexBuffer &vb = model.vertices;
+        const IndexBuffer &ib = model.indices;
+        size_t num_vertices = vb.size();
+        size_t num_instances = instances.size();
+        size_t num_triangles = ib.numTriangles();
+        if(num_vertices == 0 or num_instances == 0 or num_triangles == 0) return;
+        size_t num_vertex_attribs = vb.getLayout().numAttribs();
+        size_t num_instance_attribs = instances.getLayout().numAttribs();
+
+        FrameVector<Attribute> decoded(num_vertices * num_vertex_attribs);
+        AttribVec attrs;
+        for(size_t i = 0; i < num_vertices; i++) {
+            vb.decode(i, attrs);
+            std::copy(attrs.begin(), attrs.end(), decoded.begin() + i * num_vertex_attribs);
+        }
+
+        // Every vertex has as many varyings as the first one
+        size_t num_varyings = 0;
+        {
+            AttribVec first(num_vertex_attribs + num_instance_attribs);
+            AttribVec instance_attrs(num_instance_attribs);
+            instances.decode(0, instance_attrs);
+            std::copy(decoded.begin(), decoded.begin() + num_vertex_attribs, first.begin());
+            std::copy(instance_attrs.begin(), instance_attrs.end(),
+                      first.begin() + num_vertex_attribs);
+            num_varyings = vsh(first).attr.size();
+        }
+
+        // Screen positions, as vertex2screen gives them
+        std::vector<Vec3> positions(num_instances * num_vertices);
+        std::vector<Attribute> varyings(num_instances * num_vertices * num_varyings);
+
+        int w = fbo.getWidth(), h = fbo.getHeight();
+        #pragma omp parallel
+        {
+            FrameArena arena(64 << 10);
+            ArenaScope thread_scope(&arena);
+            AttribVec attrs(num_vertex_attribs + num_instance_attribs);
+            AttribVec instance_attrs(num_instance_attribs);
+
+            #pragma omp for schedule(dynamic)
+            for(int64_t n = 0; n < int64_t(num_instances); n++) {
+                instances.decode(n, instance_attrs);
+                std::copy(instance_attrs.begin(), instance_attrs.end(),
+                          attrs.begin() + num_vertex_attribs);
+                for(size_t i = 0; i < num_vertices; i++) {
+                    // Everything the vertex shader allocates is dropped per vertex
+                    ArenaMark vertex_scope;
+                    auto first = decoded.begin() + i * num_vertex_attribs;
+                    std::copy(first, first + num_vertex_attribs, attrs.begin());
+                    Vertex v = vsh(attrs);
 
-    std::transform(model.v_attrs.begin(), model.v_attrs.end(), vertices.begin(), vsh);
+                    size_t k = n * num_vertices + i;
+                    positions[k] = Vec3({(v.position[0] + 1.0f) * 0.5f * w,
+                                         (1.0f - v.position[1]) * 0.5f * h,
+                                         v.position[2]});
+                    std::copy_n(v.attr.begin(), std::min(v.attr.size(), num_varyings),
+                                varyings.begin() + k * num_varyings);
+                }
+            }
+        }
+
+        // Bins hold instance * num_triangles + triangle, in draw order. Rows
+        // are counted as rasterize_triangle does.
+        int num_strips = fbo.getTiles().getTilesY();
+        std::vector<std::vector<size_t>> bins(num_strips);
+        for(size_t n = 0; n < num_instances; n++) {
+            const Vec3 *p = positions.data() + n * num_vertices;
+            for(size_t t = 0; t < num_triangles; t++) {
+                const Vec3 &a = p[ib[3*t]], &b = p[ib[3*t+1]], &c = p[ib[3*t+2]];
+                float min_x = std::min({a[0], b[0], c[0]}), max_x = std::max({a[0], b[0], c[0]});
+                float min_y = std::min({a[1], b[1], c[1]}), max_y = std::max({a[1], b[1], c[1]});
+                if(!(min_x <= max_x and min_y <= max_y)) continue;
+                if(max_x < 0.0f or min_x >= w) continue;
+
+                int y0 = std::clamp(std::ceil(min_y - 0.5f), 0.0f, float(h));
+                int y1 = std::clamp(std::ceil(max_y - 0.5f), 0.0f, float(h));
+                if(y0 >= y1) continue;
+
+                size_t id = n * num_triangles + t;
+                for(int strip = y0 >> TILE_SHIFT; strip <= (y1 - 1) >> TILE_SHIFT; strip++) {
+                    bins[strip].push_back(id);
+                }
+            }
+        }
+
+        #pragma omp parallel
+        {
+            FrameArena arena(64 << 10);
+            ArenaScope thread_scope(&arena);
+
+            #pragma omp for schedule(dynamic)
+            for(int strip = 0; strip < num_strips; strip++) {
+                TileRect rect = { 0, strip * TILE_SIZE, w, std::min((strip + 1) * TILE_SIZE, h) };
+                for(size_t id : bins[strip]) {
+                    ArenaMark triangle_scope;
+                    size_t n = id / num_triangles, t = id % num_triangles;
+                    std::array<Vertex, 3> points;
+                    for(int j = 0; j < 3; j++) {
+                        size_t k = n * num_vertices + ib[3*t + j];
+                        auto first = varyings.begin() + k * num_varyings;
+                        points[j].position = positions[k];
+                        points[j].attr.assign(first, first + num_varyings);
+                    }
+                    rasterize_screen_triangle<State>(points, fsh, fbo, rect);
+                }
+            }
+        }
+    }
+}
+
+// Clips a clip space triangle against the near plane (z >= -w) and
+// rasterizes what is left as a fan of at most two triangles.
+inline void rasterize_depth_clipped(const Vec4 (&tri)[3], DepthMap &depth)
+{
+    float w = depth.getWidth(), h = depth.getHeight();
+    auto to_screen = [w, h](const Vec4 &c) {
+        return Vec3({(c[0] / c[3] + 1.0f) * 0.5f * w,
+                     (1.0f - c[1] / c[3]) * 0.5f * h,
+                     c[2] / c[3]});
+    };
+
+    Vec3 poly[4];
+    int n = 0;
+    for(int i = 0; i < 3; i++) {
+        const Vec4 &p = tri[i], &q = tri[(i + 1) % 3];
+        float dp = p[2] + p[3], dq = q[2] + q[3];
+        if(dp >= 0.0f) poly[n++] = to_screen(p);
+        if((dp >= 0.0f) != (dq >= 0.0f)) {
+            float t = dp / (dp - dq);
+            poly[n++] = to_screen(p + (q - p) * t);
+        }
+    }
+    for(int i = 2; i < n; i++) {
+        rasterize_depth(poly[0], poly[i - 1], poly[i], depth);
+    }
+}
+
+// Depth only pass, no shaders run. Attribute 0 must be the Vec3
+// position, `model_to_clip` takes it to clip space. Triangles crossing
+// the near plane are clipped against it, those fully behind it are
+// skipped. Returns the number of triangles sent.
+inline size_t draw_depth(const Model &model, const Mat4 &model_to_clip, DepthMap &depth)
+{
+    const VertexBuffer &vb = model.vertices;
+    const IndexBuffer &ib = model.indices;
+    float w = depth.getWidth(), h = depth.getHeight();
+
+    FrameVector<Vec4> clip(vb.size());
+    FrameVector<Vec3> screen(vb.size());
+    FrameVector<uint8_t> behind(vb.size());
+    float m[16];
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 4; j++) m[i * 4 + j] = model_to_clip(i, j);
+    }
+    for(size_t i = 0; i < vb.size(); i++) {
+        const float *p = vb.vertex(i);
+        Vec4 &c = clip[i];
+        for(int r = 0; r < 4; r++) {
+            c[r] = m[r*4] * p[0] + m[r*4+1] * p[1] + m[r*4+2] * p[2] + m[r*4+3];
+        }
+        behind[i] = c[2] + c[3] < 0.0f;
+        if(behind[i]) continue;
+        screen[i] = Vec3({(c[0] / c[3] + 1.0f) * 0.5f * w,
+                          (1.0f - c[1] / c[3]) * 0.5f * h,
+                          c[2] / c[3]});
+    }
 
-    for(auto &idx : model.indeces) {
-        unsigned v0, v1, v2;
-        std::tie(v0, v1, v2) = idx;
-        Triangle tri = std::forward_as_tuple(vertices[v0], vertices[v1], vertices[v2]);
-        rasterize_triangle(tri, fsh, fbo);
+    for(size_t t = 0; t < ib.numTriangles(); t++) {
+        uint32_t a = ib[3*t], b = ib[3*t+1], c = ib[3*t+2];
+        int num_behind = behind[a] + behind[b] + behind[c];
+        if(num_behind == 0) {
+            rasterize_depth(screen[a], screen[b], screen[c], depth);
+        } else if(num_behind < 3) {
+            const Vec4 tri[3] = { clip[a], clip[b], clip[c] };
+            rasterize_depth_clipped(tri, depth);
+        }
     }
+    return ib.numTriangles();
 }
 
 #endif
@@ -0,0 +1,105 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  frame_writer.cpp
+ *
+ *    Description:  Asynchronous output of rendered frames
+ *
+ *        Version:  1.0
+ *        Created:  20.10.2026 11:32:08
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "frame_writer.hpp"
+#include "png.hpp"
+
+FrameWriter::FrameWriter(int num_workers, int max_queue, int compression) :
+    max_queue(std::max(max_queue, 1)),
+    compression(compression)
+{
+    for(int i = 0; i < std::max(num_workers, 1); i++) {
+        workers.emplace_back(&FrameWriter::work, this);
+    }
+}
+
+FrameWriter::~FrameWriter()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_ready.notify_all();
+    for(auto &w : workers) {
+        w.join();
+    }
+}
+
+void FrameWriter::submit(const ColorBuffer &image, const std::string &filename)
+{
+    Job job;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        slot_free.wait(lock, [this]() { return in_flight < max_queue; });
+        in_flight++;
+        if(!free_images.empty()) {
+            job.image = std::move(free_images.back());
+            free_images.pop_back();
+        }
+    }
+
+    int w = image.getWidth();
+    int h = image.getHeight();
+    if(job.image.getWidth() != w or job.image.getHeight() != h) {
+        job.image.Resize(w, h);
+    }
+    image.toSRGB(job.image.getRawData(), 3 * w, 3);
+    job.filename = filename;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    job_ready.notify_one();
+}
+
+bool FrameWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    slot_free.wait(lock, [this]() { return in_flight == 0; });
+    bool ok = failed == 0;
+    failed = 0;
+    return ok;
+}
+
+void FrameWriter::work()
+{
+    while(true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_ready.wait(lock, [this]() { return stopping or !jobs.empty(); });
+            if(jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        const SRGBImage &img = job.image;
+        bool ok = write_png(job.filename, img.getRawData(), img.getWidth(), img.getHeight(),
+                            3, 3 * img.getWidth(), compression);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free_images.push_back(std::move(job.image));
+            if(!ok) failed++;
+            in_flight--;
+        }
+        slot_free.notify_all();
+    }
+}
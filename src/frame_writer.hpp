@@ -0,0 +1,74 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  frame_writer.hpp
+ *
+ *    Description:  Asynchronous output of rendered frames
+ *
+ *        Version:  1.0
+ *        Created:  20.10.2026 11:32:08
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef FRAME_WRITER_HPP
+#define FRAME_WRITER_HPP
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "image.hpp"
+
+// Writes frame sequences while the next frame renders. submit() converts the
+// colour buffer into a pooled sRGB snapshot on the calling thread and queues
+// it; background threads encode and write the PNGs. At most `max_queue`
+// frames wait or encode at once, further submits block until one is done.
+class FrameWriter
+{
+    struct Job
+    {
+        SRGBImage image;
+        std::string filename;
+    };
+
+    int max_queue;
+    int compression;
+
+    std::deque<Job> jobs;
+    std::vector<SRGBImage> free_images;
+    int in_flight = 0;
+    int failed = 0;
+    bool stopping = false;
+
+    std::mutex mutex;
+    std::condition_variable job_ready;
+    std::condition_variable slot_free;
+    std::vector<std::thread> workers;
+
+    void work();
+
+public:
+    // Each worker encodes one frame at a time, using OpenMP inside the frame
+    FrameWriter(int num_workers = 1, int max_queue = 3, int compression = 6);
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    void submit(const ColorBuffer &image, const std::string &filename);
+
+    // Blocks until every submitted frame is written. False if any of the
+    // frames since the last flush could not be saved.
+    bool flush();
+};
+
+#endif
@@ -19,7 +19,12 @@
 #ifndef FRAMEBUFFER_HPP
 #define FRAMEBUFFER_HPP
 
+#include <memory>
+#include <mutex>
+
 #include "image.hpp"
+#include "output.hpp"
+#include "tiles.hpp"
 
 using tmath::Vec3;
 
@@ -30,69 +35,154 @@ struct FragAttrib
     Vec3 normal;
 };
 
-template<typename AttribT>
+// Clears are lazy: they only record the value and flag every tile.
+// A flagged tile is filled on the first write that lands in it, reads of
+// single values just return the clear value, and the whole-buffer getters
+// fill every flagged tile before handing the buffer out.
+//
+// Every write and colour clear also marks its tile dirty, so outputs can
+// convert only what changed since they last took the dirty set.
+//
+// Layout selects the storage order of the depth, stencil and attribute
+// buffers. The colour buffer stays row major since it is what gets
+// displayed and saved.
+template<typename AttribT, typename Layout = LinearLayout>
 class AbstractFramebuffer
 {
+public:
+    using DepthBuffer = RenderBuffer<float, 1, Layout>;
+    using StencilBuffer = RenderBuffer<uchar, 1, Layout>;
+    using AttribBuffer = RenderBuffer<AttribT, 1, Layout>;
+
+private:
     int width, height;
 
-    RGBAImage image;
-    DepthMap depth;
-    StencilMap stencil;
+    ColorBuffer image;
+    DepthBuffer depth;
+    StencilBuffer stencil;
+
+    AttribBuffer attribs;
 
-    RenderBuffer<AttribT, 1> attribs;
+    // Weighted blended OIT, allocated by setOIT(true)
+    RGBAImage oit_accum;
+    RenderBuffer<float, 1> oit_revealage;
+    bool oit = false;
+
+    // Reused by Save so writing a sequence does not allocate per frame
+    SRGBImage staging;
 
     bool depth_test = true;
+    bool varying_attribs = false;
+
+    enum ClearBits : uint8_t {
+        CLEAR_COLOR = 1,
+        CLEAR_DEPTH = 2,
+        CLEAR_STENCIL = 4
+    };
 
+    TileGrid grid;
+    TileFlags pending_clear;
+    TileFlags dirty;
+    RGBAColor clear_color;
+    float clear_depth = 0.0f;
+    uchar clear_stencil = 0;
+
+    size_t fragment_count = 0;
 
 public:
-    AbstractFramebuffer(int width, int height) :
+    AbstractFramebuffer(int width, int height,
+                        PixelFormat format = PixelFormat::RGBA32F) :
         width(width), height(height),
-        image(width, height),
-        attribs(width, height),
+        image(width, height, format),
         depth(width, height),
-        stencil(width, height)
-    { }
+        stencil(width, height),
+        attribs(width, height),
+        oit_revealage(0, 0),
+        grid(width, height),
+        pending_clear(grid.numTiles()),
+        dirty(grid.numTiles())
+    {
+        dirty.setAll(1);
+    }
 
     void clearColor(RGBAColor init_color)
     {
-        image.Fill(init_color);
+        clear_color = init_color;
+        pending_clear.setAll(CLEAR_COLOR);
+        dirty.setAll(1);
     }
 
     void clearDepth(float init_value)
     {
-        depth.Fill(init_value);
+        clear_depth = init_value;
+        pending_clear.setAll(CLEAR_DEPTH);
     }
 
     void clearStencil(uchar init_value)
     {
-        stencil.Fill(init_value);
+        clear_stencil = init_value;
+        pending_clear.setAll(CLEAR_STENCIL);
     }
 
     void clearAll(RGBAColor c, float d = 100000.0f, uchar s = 0)
     {
-        clearColor(c);
-        clearDepth(d);
-        clearStencil(s);
+        clear_color = c;
+        clear_depth = d;
+        clear_stencil = s;
+        pending_clear.setAll(CLEAR_COLOR | CLEAR_DEPTH | CLEAR_STENCIL);
+        dirty.setAll(1);
     }
 
     bool checkDepth(int y, int x, float test)
     {
-        return !depth_test or (test < depth.value_at(y,x));
+        return !depth_test or (test < getDepthValue(x,y));
     }
 
     void putPixel(int x, int y, float depth_val,
                   const RGBAColor &color)
     {
+        touch(y,x);
         if(depth_test) {
             depth(y, x) = depth_val;
         }
 
         stencil(y,x) = 1;
-        image.setPixel(x,y, color);
+        image.store(y, x, color);
+    }
+
+    // The writes of putPixel one at a time, for raster kernels that
+    // leave some of them out. None of them look at the depth test flag.
+    void putDepth(int x, int y, float depth_val)
+    {
+        touch(y,x);
+        depth(y, x) = depth_val;
+    }
+
+    void putStencil(int x, int y, uchar value)
+    {
+        touch(y,x);
+        stencil(y, x) = value;
+    }
+
+    void putColor(int x, int y, const RGBAColor &color)
+    {
+        touch(y,x);
+        image.store(y, x, color);
+    }
+
+    // Fragment shader invocations of the raster kernels since the last
+    // reset, shows what overdraw costs
+    void countFragment(size_t n = 1)
+    {
+        #pragma omp atomic
+        fragment_count += n;
     }
+    size_t getFragmentCount() const { return fragment_count; }
+    void resetFragmentCount() { fragment_count = 0; }
 
     void putAttrib(int x, int y, AttribT attr)
     {
+        touch(y,x);
         attribs(y,x) = attr;
     }
 
@@ -101,36 +191,350 @@ public:
         int x = screen_pos[0];
         int y = screen_pos[1];
         float z = screen_pos[2];
-        if(depth_test) {
-            depth(y,x) = z;
+        putPixel(x, y, z, color);
+    }
+
+    RGBAColor getPixel(int x, int y) const
+    {
+        if(pending(y, x, CLEAR_COLOR)) return clear_color;
+        return image.load(y, x);
+    }
+
+    float getDepthValue(int x, int y) const
+    {
+        if(pending(y, x, CLEAR_DEPTH)) return clear_depth;
+        return depth.value_at(y,x);
+    }
+
+    uchar getStencilValue(int x, int y) const
+    {
+        if(pending(y, x, CLEAR_STENCIL)) return clear_stencil;
+        return stencil.value_at(y,x);
+    }
+
+    // Tiles still holding a pending clear of the stencil to zero have never
+    // been drawn to since that clear, full-screen passes can skip them.
+    const TileGrid& getTiles() const { return grid; }
+    bool tileUntouched(int tile) const
+    {
+        return (pending_clear.get(tile) & CLEAR_STENCIL) and clear_stencil == 0;
+    }
+
+    // For code that writes through getImage() and friends directly
+    void markDirty(int y0, int x0, int y1, int x1)
+    {
+        for(int ty = y0 >> TILE_SHIFT; ty <= (y1 - 1) >> TILE_SHIFT; ty++) {
+            for(int tx = x0 >> TILE_SHIFT; tx <= (x1 - 1) >> TILE_SHIFT; tx++) {
+                dirty.set(ty * grid.getTilesX() + tx, 1);
+            }
         }
-        stencil(y,x) = 1;
-        image.setPixel(x, y, color);
+    }
+    void markAllDirty() { dirty.setAll(1); }
+
+    bool tileDirty(int tile) const { return dirty.get(tile) != 0; }
+    void resetDirty() { dirty.clear(); }
+
+    // Makes a tile equal to the same tile of `src`, which must have the
+    // same size and format. Pending clears of `src` are copied as values.
+    // The tile is not marked dirty.
+    void copyTile(const AbstractFramebuffer &src, int tile)
+    {
+        materialize(tile);
+        TileRect r = grid.rect(tile);
+        uint8_t bits = src.pending_clear.get(tile);
+        if(bits & CLEAR_COLOR) {
+            image.FillRect(r.y0, r.x0, r.y1, r.x1, src.clear_color);
+        } else {
+            image.CopyRect(src.image, r.y0, r.x0, r.y1, r.x1);
+        }
+        if(bits & CLEAR_DEPTH) {
+            depth.FillRect(r.y0, r.x0, r.y1, r.x1, src.clear_depth);
+        } else {
+            depth.CopyRect(src.depth, r.y0, r.x0, r.y1, r.x1);
+        }
+        if(bits & CLEAR_STENCIL) {
+            stencil.FillRect(r.y0, r.x0, r.y1, r.x1, src.clear_stencil);
+        } else {
+            stencil.CopyRect(src.stencil, r.y0, r.x0, r.y1, r.x1);
+        }
+        attribs.CopyRect(src.attribs, r.y0, r.x0, r.y1, r.x1);
+    }
+
+    // Merged rectangles of everything written since the last call
+    std::vector<TileRect> takeDirtyRects()
+    {
+        auto rects = grid.mergeRects([this](int t) { return tileDirty(t); });
+        resetDirty();
+        return rects;
     }
 
-    int getWidth() { return width; }
-    int getHeight() { return height; }
+    // Fills every tile that still has a pending clear
+    void resolve()
+    {
+        #pragma omp parallel for schedule(dynamic)
+        for(int t = 0; t < grid.numTiles(); t++) {
+            materialize(t);
+        }
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
     void setDepthTest(bool depth_flag) { depth_test = depth_flag; }
     bool depthEnabled() { return depth_test; }
-    void Save(const std::string &filename)
+
+    // Rasterized fragments also store their first two varyings, which
+    // must be Vec3 world position and normal, as attributes. Lets meshes
+    // fill the same G-buffer as the ray marcher.
+    void setVaryingAttribs(bool flag) { varying_attribs = flag; }
+    bool varyingAttribsEnabled() const { return varying_attribs; }
+    PixelFormat getFormat() const { return image.getFormat(); }
+
+    // Order independent transparency: fragments of BlendMode::WeightedOIT
+    // draws are summed into an accumulation buffer instead of blended in
+    // draw order, and resolveOIT() composites the sum over the colour.
+    // Memory is fixed at 20 bytes per pixel however many layers overlap,
+    // a fragment costs O(1) and resolving O(pixels). The result
+    // approximates sorted blending: exact for one layer, close when the
+    // layers' colours or alphas are similar.
+    void setOIT(bool flag)
+    {
+        oit = flag;
+        if(oit and oit_accum.getWidth() != width) {
+            oit_accum = RGBAImage(width, height);
+            oit_revealage = RenderBuffer<float, 1>(width, height);
+            clearOIT();
+        }
+    }
+    bool oitEnabled() const { return oit; }
+
+    void clearOIT()
     {
-        auto rgb = image_a2s(image);
-        save_image(rgb, filename);
+        oit_accum.Fill(RGBAColor({0, 0, 0, 0}));
+        oit_revealage.Fill(1.0f);
     }
 
-    RGBAImage &getImage() { return image; }
-    DepthMap &getDepth() { return depth; }
-    StencilMap &getStencil() { return stencil; }
-    RenderBuffer<AttribT, 1> &getAttribs() { return attribs; }
+    // Adds `n` fragments of row y starting at x, RGBA colours and NDC
+    // depths. Transparent ones add nothing.
+    void accumulateOIT(int y, int x, int n, const float *colors, const float *depths)
+    {
+        float *accum = reinterpret_cast<float*>(&oit_accum(y, x));
+        oit_accumulate_span(colors, depths, accum, &oit_revealage(y, x), n);
+    }
+
+    // Composites and clears the accumulated fragments, in parallel over rows
+    void resolveOIT()
+    {
+        if(!oit) return;
+        // Rows share tiles, so no clears may be left to race on
+        resolve();
+        #pragma omp parallel
+        {
+            std::vector<float> row(width * 4);
+
+            #pragma omp for
+            for(int y = 0; y < height; y++) {
+                const float *revealage = &oit_revealage(y, 0);
+                int x0 = 0;
+                while(x0 < width and revealage[x0] == 1.0f) x0++;
+                int x1 = width;
+                while(x1 > x0 and revealage[x1 - 1] == 1.0f) x1--;
+                if(x0 == x1) continue;
+
+                for(int x = x0; x < x1; x++) {
+                    RGBAColor c = getPixel(x, y);
+                    for(int i = 0; i < 4; i++) row[x * 4 + i] = c[i];
+                }
+                oit_composite_span(reinterpret_cast<const float*>(&oit_accum(y, x0)),
+                                   revealage + x0, &row[x0 * 4], x1 - x0);
+                for(int x = x0; x < x1; x++) {
+                    if(revealage[x] == 1.0f) continue;
+                    putColor(x, y, RGBAColor({row[x*4], row[x*4+1], row[x*4+2], row[x*4+3]}));
+                }
+            }
+        }
+        clearOIT();
+    }
+    // The format follows the extension: .ppm and .pfm are written
+    // uncompressed straight from the colour buffer, anything else is PNG.
+    void Save(const std::string &filename, Dither dither = Dither::None)
+    {
+        switch(image_format_from_name(filename)) {
+        case ImageFileFormat::PPM:
+            write_ppm(getImage(), filename, dither);
+            return;
+        case ImageFileFormat::PFM:
+            write_pfm(getImage(), filename);
+            return;
+        case ImageFileFormat::PNG:
+            break;
+        }
+
+        if(staging.getWidth() != width or staging.getHeight() != height) {
+            staging.Resize(width, height);
+        }
+        getImage().toSRGB(staging.getRawData(), 3 * width, 3, dither);
+        save_image(staging, filename);
+    }
+
+    ColorBuffer &getImage() { resolve(); return image; }
+    DepthBuffer &getDepth() { resolve(); return depth; }
+    StencilBuffer &getStencil() { resolve(); return stencil; }
+    AttribBuffer &getAttribs() { return attribs; }
+
+private:
+    bool pending(int y, int x, uint8_t bits) const
+    {
+        return pending_clear.get(grid.tileAt(y,x)) & bits;
+    }
+
+    void touch(int y, int x)
+    {
+        int tile = grid.tileAt(y,x);
+        if(pending_clear.get(tile)) {
+            materialize(tile);
+        }
+        // Plain load first, most writes land in tiles that are already dirty
+        if(!dirty.get(tile)) {
+            dirty.set(tile, 1);
+        }
+    }
+
+    void materialize(int tile)
+    {
+        pending_clear.consume(tile, [this, tile](uint8_t bits) {
+            TileRect r = grid.rect(tile);
+            if(bits & CLEAR_COLOR) {
+                image.FillRect(r.y0, r.x0, r.y1, r.x1, clear_color);
+            }
+            if(bits & CLEAR_DEPTH) {
+                depth.FillRect(r.y0, r.x0, r.y1, r.x1, clear_depth);
+            }
+            if(bits & CLEAR_STENCIL) {
+                stencil.FillRect(r.y0, r.x0, r.y1, r.x1, clear_stencil);
+            }
+        });
+    }
 };
 
 using Framebuffer = AbstractFramebuffer<FragAttrib>;
+using TiledFramebuffer = AbstractFramebuffer<FragAttrib, TiledLayout>;
 using SimpleFB = AbstractFramebuffer<float>;
 
-inline Framebuffer fb_like(Framebuffer &other)
+template<typename AttribT, typename Layout>
+inline AbstractFramebuffer<AttribT, Layout> fb_like(const AbstractFramebuffer<AttribT, Layout> &other)
 {
-    return Framebuffer(other.getWidth(), other.getHeight());
+    return AbstractFramebuffer<AttribT, Layout>(other.getWidth(), other.getHeight(), other.getFormat());
 }
 
+// Non-owning reference to a framebuffer. Cheap to copy, so render targets
+// can be bound as uniforms without duplicating their buffers.
+template<typename FB>
+class FramebufferRef
+{
+    FB *fb;
+public:
+    FramebufferRef(FB &fb) : fb(&fb) { }
+
+    FB& get() const { return *fb; }
+    FB& operator*() const { return *fb; }
+    FB* operator->() const { return fb; }
+};
+
+using FramebufferView = FramebufferRef<Framebuffer>;
+
+// Keeps released render targets around and hands them out again when a
+// target of the same size and format is requested, so per-frame temporaries
+// stop allocating. Handles return their target on destruction and must not
+// outlive the pool.
+template<typename FB>
+class RenderTargetPool
+{
+    std::vector<std::unique_ptr<FB>> free_targets;
+    std::mutex mutex;
+    size_t num_allocated = 0;
+
+public:
+    class Handle
+    {
+        RenderTargetPool *pool = nullptr;
+        std::unique_ptr<FB> fb;
+    public:
+        Handle() { }
+        Handle(RenderTargetPool *pool, std::unique_ptr<FB> fb) :
+            pool(pool), fb(std::move(fb))
+        { }
+
+        Handle(Handle &&other) = default;
+        Handle& operator=(Handle &&other)
+        {
+            release();
+            pool = other.pool;
+            fb = std::move(other.fb);
+            return *this;
+        }
+
+        ~Handle() { release(); }
+
+        void release()
+        {
+            if(fb) pool->recycle(std::move(fb));
+        }
+
+        FB& operator*() const { return *fb; }
+        FB* operator->() const { return fb.get(); }
+        FB* get() const { return fb.get(); }
+        FramebufferRef<FB> view() const { return FramebufferRef<FB>(*fb); }
+    };
+
+    // The target comes back cleared to transparent black
+    Handle acquire(int width, int height, PixelFormat format = PixelFormat::RGBA32F)
+    {
+        std::unique_ptr<FB> fb;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = std::find_if(free_targets.begin(), free_targets.end(),
+                    [&](const std::unique_ptr<FB> &t) {
+                        return t->getWidth() == width and t->getHeight() == height
+                            and t->getFormat() == format;
+                    });
+            if(it != free_targets.end()) {
+                fb = std::move(*it);
+                free_targets.erase(it);
+            } else {
+                num_allocated++;
+            }
+        }
+
+        if(!fb) {
+            fb = std::make_unique<FB>(width, height, format);
+        }
+        fb->clearAll(RGBAColor());
+        return Handle(this, std::move(fb));
+    }
+
+    Handle acquireLike(const FB &other)
+    {
+        return acquire(other.getWidth(), other.getHeight(), other.getFormat());
+    }
+
+    // Frees every target that is not handed out
+    void trim()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_targets.clear();
+    }
+
+    size_t numAllocated() const { return num_allocated; }
+
+private:
+    void recycle(std::unique_ptr<FB> fb)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_targets.push_back(std::move(fb));
+    }
+};
+
+using FramebufferPool = RenderTargetPool<Framebuffer>;
+
 
 #endif
@@ -0,0 +1,188 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  gbuffer.cpp
+ *
+ *    Description:  Reading and writing of G-buffer files
+ *
+ *        Version:  1.0
+ *        Created:  21.10.2026 09:41:13
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "gbuffer.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char GBUFFER_MAGIC[4] = { 'T', 'G', 'G', 'B' };
+static const uint64_t PLANE_ALIGN = 64;
+
+GBufferFileWriter::GBufferFileWriter(const std::string &filename, int width, int height,
+                                     const Vec3 &cam_pos) :
+    f(fopen(filename.c_str(), "wb")),
+    cursor(sizeof(GBufferHeader))
+{
+    if(!f) {
+        std::cout << "Can't save G-buffer: " << filename << std::endl;
+        return;
+    }
+
+    std::memcpy(header.magic, GBUFFER_MAGIC, 4);
+    header.version = GBUFFER_VERSION;
+    header.width = width;
+    header.height = height;
+    for(int i = 0; i < 3; i++) header.cam_pos[i] = cam_pos[i];
+
+    // Room for the header, it is written last
+    fwrite(&header, sizeof(header), 1, f);
+}
+
+GBufferFileWriter::~GBufferFileWriter()
+{
+    if(f) fclose(f);
+}
+
+void GBufferFileWriter::beginPlane(GBufferPlaneKind kind, GBufferScalar scalar, int channels)
+{
+    if(!f or header.num_planes == GBUFFER_MAX_PLANES) return;
+
+    uint64_t aligned = (cursor + PLANE_ALIGN - 1) / PLANE_ALIGN * PLANE_ALIGN;
+    static const uchar zeros[PLANE_ALIGN] = { };
+    fwrite(zeros, 1, aligned - cursor, f);
+    cursor = aligned;
+
+    GBufferPlane &p = header.planes[header.num_planes++];
+    p.kind = uint32_t(kind);
+    p.scalar = uint32_t(scalar);
+    p.channels = channels;
+    p.offset = cursor;
+    p.size = uint64_t(header.width) * header.height * channels * gbuffer_scalar_size(scalar);
+    row_bytes.resize(size_t(header.width) * channels * gbuffer_scalar_size(scalar));
+}
+
+void GBufferFileWriter::writeRow(const float *values)
+{
+    if(!f or header.num_planes == 0) return;
+
+    const GBufferPlane &p = header.planes[header.num_planes - 1];
+    size_t n = size_t(header.width) * p.channels;
+    switch(GBufferScalar(p.scalar)) {
+    case GBufferScalar::F32:
+        std::memcpy(row_bytes.data(), values, n * 4);
+        break;
+    case GBufferScalar::F16:
+        float_to_half_row(values, reinterpret_cast<uint16_t*>(row_bytes.data()), n);
+        break;
+    case GBufferScalar::U8:
+        for(size_t i = 0; i < n; i++) row_bytes[i] = uchar(values[i]);
+        break;
+    }
+
+    fwrite(row_bytes.data(), 1, row_bytes.size(), f);
+    cursor += row_bytes.size();
+}
+
+void GBufferFileWriter::writeRow(const uchar *values)
+{
+    if(!f or header.num_planes == 0) return;
+
+    size_t n = size_t(header.width) * header.planes[header.num_planes - 1].channels;
+    fwrite(values, 1, n, f);
+    cursor += n;
+}
+
+bool GBufferFileWriter::finish()
+{
+    if(!f) return false;
+
+    bool ok = !ferror(f);
+    ok = ok and fseek(f, 0, SEEK_SET) == 0;
+    ok = ok and fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = fclose(f) == 0 and ok;
+    f = nullptr;
+    return ok;
+}
+
+MappedGBuffer::MappedGBuffer(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0 or fstat(fd, &st) != 0) {
+        std::cout << "Can't open G-buffer: " << filename << std::endl;
+        if(fd >= 0) close(fd);
+        return;
+    }
+
+    file_size = st.st_size;
+    void *ptr = file_size >= sizeof(GBufferHeader) ?
+        mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(ptr == MAP_FAILED) {
+        std::cout << "Can't map G-buffer: " << filename << std::endl;
+        return;
+    }
+    data = static_cast<const uchar*>(ptr);
+
+    auto *h = reinterpret_cast<const GBufferHeader*>(data);
+    if(std::memcmp(h->magic, GBUFFER_MAGIC, 4) != 0 or h->version != GBUFFER_VERSION) {
+        std::cout << "Not a G-buffer or unsupported version: " << filename << std::endl;
+        return;
+    }
+
+    for(uint32_t i = 0; i < std::min<uint32_t>(h->num_planes, GBUFFER_MAX_PLANES); i++) {
+        const GBufferPlane &p = h->planes[i];
+        if(p.kind >= GBUFFER_MAX_PLANES or p.channels == 0) continue;
+
+        // Only accept planes whose stored size matches what load() will index
+        size_t scalar_size = p.scalar <= uint32_t(GBufferScalar::U8) ?
+            gbuffer_scalar_size(GBufferScalar(p.scalar)) : 0;
+        if(scalar_size == 0) continue;
+        size_t texels = size_t(h->width) * h->height;
+        if(h->width != 0 and texels / h->width != h->height) continue;
+        if(texels > file_size / (size_t(p.channels) * scalar_size)) continue;
+        if(p.size != texels * p.channels * scalar_size) continue;
+        if(p.offset > file_size or p.size > file_size - p.offset) continue;
+        planes[p.kind] = &p;
+    }
+    header = h;
+}
+
+MappedGBuffer::~MappedGBuffer()
+{
+    if(data) {
+        munmap(const_cast<uchar*>(data), file_size);
+    }
+}
+
+float MappedGBuffer::load(GBufferPlaneKind kind, int y, int x, int ch) const
+{
+    const GBufferPlane *p = planes[uint32_t(kind)];
+    if(!p) return 0.0f;
+
+    size_t idx = (size_t(y) * header->width + x) * p->channels + ch;
+    const uchar *base = data + p->offset;
+    switch(GBufferScalar(p->scalar)) {
+    case GBufferScalar::F32: {
+        float v;
+        std::memcpy(&v, base + idx * 4, 4);
+        return v;
+    }
+    case GBufferScalar::F16: {
+        uint16_t v;
+        std::memcpy(&v, base + idx * 2, 2);
+        return half_to_float(v);
+    }
+    case GBufferScalar::U8:
+        return base[idx];
+    }
+    return 0.0f;
+}
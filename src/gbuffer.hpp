@@ -0,0 +1,229 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  gbuffer.hpp
+ *
+ *    Description:  Binary G-buffer dumps for relighting without re-tracing
+ *
+ *        Version:  1.0
+ *        Created:  21.10.2026 09:41:13
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef GBUFFER_HPP
+#define GBUFFER_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "framebuffer.hpp"
+
+/*
+ * File layout (little endian):
+ *   GBufferHeader                 fixed size, holds the plane table
+ *   plane data                    each plane row major, 64 byte aligned
+ *
+ * Readers must check magic and version. Planes are found through the
+ * table only, so new plane kinds can be appended without breaking old
+ * readers.
+ */
+
+const uint32_t GBUFFER_VERSION = 1;
+const int GBUFFER_MAX_PLANES = 8;
+
+enum class GBufferPlaneKind : uint32_t {
+    Color = 0,      // RGBA, linear
+    Depth = 1,      // 1 channel, ray distance or raster depth
+    Stencil = 2,    // 1 channel, non zero where something was drawn
+    Position = 3,   // XYZ, world space
+    Normal = 4      // XYZ, world space
+};
+
+enum class GBufferScalar : uint32_t {
+    F32 = 0,
+    F16 = 1,
+    U8 = 2
+};
+
+struct GBufferPlane
+{
+    uint32_t kind;
+    uint32_t scalar;
+    uint32_t channels;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct GBufferHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    float cam_pos[3];
+    uint32_t num_planes;
+    GBufferPlane planes[GBUFFER_MAX_PLANES];
+};
+
+inline size_t gbuffer_scalar_size(GBufferScalar s)
+{
+    switch(s) {
+    case GBufferScalar::F32: return 4;
+    case GBufferScalar::F16: return 2;
+    case GBufferScalar::U8: return 1;
+    }
+    return 0;
+}
+
+// Streams planes into a G-buffer file, one row at a time
+class GBufferFileWriter
+{
+    FILE *f;
+    GBufferHeader header = { };
+    std::vector<uchar> row_bytes;
+    uint64_t cursor;
+
+public:
+    GBufferFileWriter(const std::string &filename, int width, int height, const Vec3 &cam_pos);
+    ~GBufferFileWriter();
+
+    bool isOpen() const { return f != nullptr; }
+
+    // Starts a new plane, rows follow through writeRow in order
+    void beginPlane(GBufferPlaneKind kind, GBufferScalar scalar, int channels);
+    // Takes width * channels floats (or bytes for U8 planes as floats)
+    void writeRow(const float *values);
+    void writeRow(const uchar *values);
+
+    // Writes the header, returns false if anything failed
+    bool finish();
+};
+
+// Writes colour, depth, stencil, position and normal of a framebuffer.
+// With `half` the colour, position and normal planes are stored as half
+// floats, depth always stays 32 bit.
+template<typename FB>
+bool write_gbuffer(FB &fb, const std::string &filename, const Vec3 &cam_pos,
+                   bool half = false)
+{
+    int w = fb.getWidth();
+    int h = fb.getHeight();
+    GBufferFileWriter out(filename, w, h, cam_pos);
+    if(!out.isOpen()) return false;
+
+    GBufferScalar vec_scalar = half ? GBufferScalar::F16 : GBufferScalar::F32;
+    std::vector<float> row(size_t(w) * 4);
+
+    auto &image = fb.getImage();
+    out.beginPlane(GBufferPlaneKind::Color, vec_scalar, 4);
+    for(int y = 0; y < h; y++) {
+        image.loadRow(y, row.data());
+        out.writeRow(row.data());
+    }
+
+    auto &depth = fb.getDepth();
+    out.beginPlane(GBufferPlaneKind::Depth, GBufferScalar::F32, 1);
+    for(int y = 0; y < h; y++) {
+        depth.linearize(row.data(), y, y + 1);
+        out.writeRow(row.data());
+    }
+
+    auto &stencil = fb.getStencil();
+    std::vector<uchar> stencil_row(w);
+    out.beginPlane(GBufferPlaneKind::Stencil, GBufferScalar::U8, 1);
+    for(int y = 0; y < h; y++) {
+        stencil.linearize(stencil_row.data(), y, y + 1);
+        out.writeRow(stencil_row.data());
+    }
+
+    auto &attrs = fb.getAttribs();
+    const GBufferPlaneKind kinds[2] = { GBufferPlaneKind::Position, GBufferPlaneKind::Normal };
+    for(int k = 0; k < 2; k++) {
+        out.beginPlane(kinds[k], vec_scalar, 3);
+        for(int y = 0; y < h; y++) {
+            for(int x = 0; x < w; x++) {
+                const auto &a = attrs(y,x);
+                const Vec3 &v = k == 0 ? a.pos : a.normal;
+                for(int c = 0; c < 3; c++) row[x * 3 + c] = v[c];
+            }
+            out.writeRow(row.data());
+        }
+    }
+
+    return out.finish();
+}
+
+// Read-only mapping of a G-buffer file. Accessors decode the stored
+// scalar type, missing planes read as zero.
+class MappedGBuffer
+{
+    const uchar *data = nullptr;
+    size_t file_size = 0;
+    const GBufferHeader *header = nullptr;
+    const GBufferPlane *planes[GBUFFER_MAX_PLANES] = { };
+
+    float load(GBufferPlaneKind kind, int y, int x, int ch) const;
+
+public:
+    MappedGBuffer(const std::string &filename);
+    ~MappedGBuffer();
+
+    MappedGBuffer(const MappedGBuffer&) = delete;
+    MappedGBuffer& operator=(const MappedGBuffer&) = delete;
+
+    bool isOpen() const { return header != nullptr; }
+    int getWidth() const { return header->width; }
+    int getHeight() const { return header->height; }
+    Vec3 getCameraPos() const
+    {
+        return Vec3({header->cam_pos[0], header->cam_pos[1], header->cam_pos[2]});
+    }
+
+    bool hasPlane(GBufferPlaneKind kind) const
+    {
+        return planes[uint32_t(kind)] != nullptr;
+    }
+
+    RGBAColor color(int y, int x) const
+    {
+        return RGBAColor({
+                load(GBufferPlaneKind::Color, y, x, 0),
+                load(GBufferPlaneKind::Color, y, x, 1),
+                load(GBufferPlaneKind::Color, y, x, 2),
+                load(GBufferPlaneKind::Color, y, x, 3)
+                });
+    }
+
+    float depth(int y, int x) const { return load(GBufferPlaneKind::Depth, y, x, 0); }
+    bool stencil(int y, int x) const { return load(GBufferPlaneKind::Stencil, y, x, 0) != 0; }
+
+    Vec3 position(int y, int x) const
+    {
+        return Vec3({
+                load(GBufferPlaneKind::Position, y, x, 0),
+                load(GBufferPlaneKind::Position, y, x, 1),
+                load(GBufferPlaneKind::Position, y, x, 2)
+                });
+    }
+
+    Vec3 normal(int y, int x) const
+    {
+        return Vec3({
+                load(GBufferPlaneKind::Normal, y, x, 0),
+                load(GBufferPlaneKind::Normal, y, x, 1),
+                load(GBufferPlaneKind::Normal, y, x, 2)
+                });
+    }
+};
+
+#endif
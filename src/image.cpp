@@ -29,40 +29,62 @@ void save_image(const SRGBImage &img, const std::string &filename)
     }
 }
 
-SRGBImage image_a2s(const RGBAImage &src)
+SRGBImage::SRGBImage(const RGBAImage &other) :
+    Array3D<uchar>(other.getWidth(), other.getHeight(), 3)
+{
+    image_a2s(other, getRawData(), 3 * width, 3);
+}
+
+void image_a2s(const RGBAImage &src, uchar *dst, int pitch, int channels, Dither dither)
 {
     int w = src.getWidth();
     int h = src.getHeight();
+    const float *data = reinterpret_cast<const float*>(src.getRawData());
 
-    SRGBImage res(w, h);
+    #pragma omp parallel for
     for(int y = 0; y < h; y++) {
-        for(int x = 0; x < w; x++) {
-            for(int c = 0; c < 3; c++) {
-                float val = src.value_at(y,x)[c];
-                res.at(y,x,c) = val * 255;
-            }
-        }
+        encode_srgb_row(data + size_t(y) * w * 4, dst + size_t(y) * pitch, w, channels, dither, y);
+    }
+}
+
+void image_a2s(const RGBAImage &src, SRGBImage &dst, Dither dither)
+{
+    int w = src.getWidth();
+    int h = src.getHeight();
+    if(dst.getWidth() != w or dst.getHeight() != h) {
+        dst.Resize(w, h);
     }
 
+    image_a2s(src, dst.getRawData(), 3 * w, 3, dither);
+}
+
+SRGBImage image_a2s(const RGBAImage &src, Dither dither)
+{
+    SRGBImage res(src.getWidth(), src.getHeight());
+    image_a2s(src, res, dither);
     return res;
 }
 
-RGBAImage image_s2a(const SRGBImage &src)
+void image_s2a(const SRGBImage &src, RGBAImage &dst)
 {
     int w = src.getWidth();
     int h = src.getHeight();
+    if(dst.getWidth() != w or dst.getHeight() != h) {
+        dst.Resize(w, h);
+    }
 
-    RGBAImage res(w, h);
-    for(int y = 0; y < h; y++) {
-        for(int x = 0; x < w; x++) {
-            for(int c = 0; c < 3; c++) {
-                res.at(y,x)[c] = src.value_at(y,x,c);
-            }
+    const uchar *data = src.getRawData();
+    float *res = reinterpret_cast<float*>(dst.getRawData());
 
-            res.at(y,x)[3] = 1.0f;
-        }
+    #pragma omp parallel for
+    for(int y = 0; y < h; y++) {
+        decode_srgb_row(data + size_t(y) * w * 3, res + size_t(y) * w * 4, w, 3);
     }
+}
 
+RGBAImage image_s2a(const SRGBImage &src)
+{
+    RGBAImage res(src.getWidth(), src.getHeight());
+    image_s2a(src, res);
     return res;
 }
-
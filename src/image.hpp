@@ -20,62 +20,158 @@
 #define IMAGE_HPP
 
 #include "color.hpp"
+#include "pixel_format.hpp"
 
-using uchar = unsigned char;
+// Pixel (y,x) lives at y * stride + x
+struct LinearLayout
+{
+    static int padded(int size) { return size; }
+
+    static size_t index(int y, int x, int stride)
+    {
+        return size_t(y) * stride + x;
+    }
+
+    // Number of pixels from x (until x_end) that follow each other in memory
+    static int run(int x, int x_end) { return x_end - x; }
+};
+
+// Block linear: 8x8 blocks are stored one after another in row order,
+// pixels inside a block are row major. A block of any 2D neighbourhood
+// shares a few cache lines and a page instead of 8 rows of the image.
+struct TiledLayout
+{
+    static const int SHIFT = 3;
+    static const int BLOCK = 1 << SHIFT;
+    static const int MASK = BLOCK - 1;
+
+    static int padded(int size) { return (size + MASK) & ~MASK; }
 
-template<typename T>
+    static size_t index(int y, int x, int stride)
+    {
+        size_t block = size_t(y >> SHIFT) * (stride >> SHIFT) + (x >> SHIFT);
+        return (block << (2 * SHIFT)) + ((y & MASK) << SHIFT) + (x & MASK);
+    }
+
+    static int run(int x, int x_end) { return std::min(x_end - x, BLOCK - (x & MASK)); }
+};
+
+template<typename T, typename Layout = LinearLayout>
 class Array3D
 {
 protected:
     int width, height;
     int num_channels;
+    int stride;
     std::vector<T> values;
+
+    void resize(int new_width, int new_height, int new_channels)
+    {
+        width = new_width;
+        height = new_height;
+        num_channels = new_channels;
+        stride = Layout::padded(width);
+        values.resize(size_t(stride) * Layout::padded(height) * num_channels);
+    }
+
+    size_t index(int y, int x, int ch) const
+    {
+        return Layout::index(y, x, stride) * num_channels + ch;
+    }
 public:
-    Array3D() { }
-    Array3D(int width, int height, int num_channels) :
-        width(width), height(height), num_channels(num_channels)
+    Array3D() : width(0), height(0), num_channels(0), stride(0) { }
+    Array3D(int width, int height, int num_channels)
     {
-        values.resize(width * height * num_channels);
+        resize(width, height, num_channels);
     }
 
     Array3D(const Array3D &other) :
         width(other.width),
         height(other.height),
         num_channels(other.num_channels),
+        stride(other.stride),
         values(other.values)
     { }
 
+    Array3D(Array3D &&other) = default;
+    Array3D& operator=(const Array3D &other) = default;
+    Array3D& operator=(Array3D &&other) = default;
+
     int getWidth() const { return width; }
     int getHeight() const { return height; }
-    int getNumChannels() { return num_channels; }
+    int getNumChannels() const { return num_channels; }
 
     T& operator() (int y, int x, int ch = 0)
     {
-        return values[(y * width + x) * num_channels + ch];
+        return values[index(y, x, ch)];
     }
 
     T& at(int y, int x, int ch = 0)
     {
-        return values[(y * width + x) * num_channels + ch];
+        return values[index(y, x, ch)];
     }
 
     T value_at(int y, int x, int ch = 0) const
     {
-        return values[(y * width + x) * num_channels + ch];
+        return values[index(y, x, ch)];
     }
 
+    // Storage in Layout order. Row major only for LinearLayout,
+    // use linearize() to get row major data from any layout.
     const T* getRawData() const
     {
         return values.data();
     }
 
+    T* getRawData()
+    {
+        return values.data();
+    }
+
     void Fill(T value)
     {
-        for(int y = 0; y < height; y++) {
-            for(int x = 0; x < width; x++) {
-                for(int c = 0; c < num_channels; c++) {
-                    at(y,x,c) = value;
-                }
+        std::fill(values.begin(), values.end(), value);
+    }
+
+    // Fills rows [y0, y1) and columns [x0, x1)
+    void FillRect(int y0, int x0, int y1, int x1, T value)
+    {
+        for(int y = y0; y < y1; y++) {
+            for(int x = x0; x < x1; ) {
+                int n = Layout::run(x, x1);
+                auto it = values.begin() + index(y, x, 0);
+                std::fill(it, it + n * num_channels, value);
+                x += n;
+            }
+        }
+    }
+
+    // Copies rows [y0, y1) and columns [x0, x1) from an array of the same size
+    void CopyRect(const Array3D &src, int y0, int x0, int y1, int x1)
+    {
+        for(int y = y0; y < y1; y++) {
+            for(int x = x0; x < x1; ) {
+                int n = Layout::run(x, x1);
+                size_t i = index(y, x, 0);
+                std::copy_n(src.values.begin() + i, n * num_channels, values.begin() + i);
+                x += n;
+            }
+        }
+    }
+
+    // Copies rows [y0, y1) into dst in row major order, width * num_channels
+    // values per row. A plain copy for LinearLayout, contiguous runs of a
+    // block row otherwise.
+    void linearize(T *dst, int y0 = 0, int y1 = -1) const
+    {
+        if(y1 < 0) y1 = height;
+        for(int y = y0; y < y1; y++) {
+            T *row = dst + size_t(y - y0) * width * num_channels;
+            for(int x = 0; x < width; ) {
+                int n = Layout::run(x, width);
+                auto it = values.begin() + index(y, x, 0);
+                std::copy(it, it + n * num_channels, row + x * num_channels);
+                x += n;
             }
         }
     }
@@ -84,7 +180,7 @@ public:
 class RGBAImage : public Array3D<RGBAColor>
 {
 public:
-    RGBAImage();
+    RGBAImage() { }
     RGBAImage(int width, int height) :
         Array3D<RGBAColor>(width, height, 1)
     { }
@@ -93,9 +189,7 @@ public:
 
     void Resize(int new_width, int new_height)
     {
-        width = new_width;
-        height = new_height;
-        values.resize(height * width * num_channels);
+        resize(new_width, new_height, 1);
     }
 
     //void Save(const std::string &save_path) { // TODO}
@@ -112,44 +206,286 @@ public:
 class SRGBImage : public Array3D<uchar>
 {
 public:
+    SRGBImage() { }
     SRGBImage(int width, int height) :
         Array3D<uchar>(width, height, 3)
     { }
 
-    SRGBImage(const RGBAImage &other) :
-        Array3D<uchar>(other.getWidth(), other.getHeight(), 3)
+    SRGBImage(const RGBAImage &other);
+
+    void Resize(int new_width, int new_height)
     {
-        int w = getWidth();
-        int h = getHeight();
-        for(int y = 0; y < h; y++) {
-            for(int x = 0; x < w; x++) {
-                for(int c = 0; c < 3; c++) {
-                    at(y,x,c) = other.value_at(y,x)[c] * 255;
-                }
-            }
-        }
+        resize(new_width, new_height, 3);
     }
 };
 
 
-template<typename T, int NUM_CHANNELS>
-class RenderBuffer : public Array3D<T>
+template<typename T, int NUM_CHANNELS, typename Layout = LinearLayout>
+class RenderBuffer : public Array3D<T, Layout>
 {
 public:
     RenderBuffer(int width, int height) :
-        Array3D<T>(width, height, NUM_CHANNELS)
+        Array3D<T, Layout>(width, height, NUM_CHANNELS)
     { }
 };
 
+// Row kernels treat an RGBAImage as a flat array of floats
+static_assert(sizeof(RGBAColor) == 4 * sizeof(float), "RGBAColor must be 4 packed floats");
+
+// Colour attachment of a framebuffer. Only the storage of the selected
+// format is allocated, pixels are packed on store and unpacked on load.
+class ColorBuffer
+{
+    int width, height;
+    PixelFormat format;
+
+    RGBAImage rgba32;
+    Array3D<uint16_t> rgba16;
+    Array3D<uchar> rgba8;
+public:
+    ColorBuffer(int width, int height, PixelFormat format = PixelFormat::RGBA32F) :
+        width(width), height(height), format(format),
+        rgba32(storage_width(PixelFormat::RGBA32F), height),
+        rgba16(storage_width(PixelFormat::RGBA16F), height, 4),
+        rgba8(storage_width(PixelFormat::RGBA8_SRGB), height, 4)
+    { }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    PixelFormat getFormat() const { return format; }
+
+    void store(int y, int x, const RGBAColor &color)
+    {
+        switch(format) {
+        case PixelFormat::RGBA8_SRGB:
+            pack_rgba8(color, &rgba8(y,x));
+            break;
+        case PixelFormat::RGBA16F:
+            pack_rgba16f(color, &rgba16(y,x));
+            break;
+        case PixelFormat::RGBA32F:
+            rgba32(y,x) = color;
+            break;
+        }
+    }
+
+    RGBAColor load(int y, int x) const
+    {
+        switch(format) {
+        case PixelFormat::RGBA8_SRGB:
+            return unpack_rgba8(rgba8.getRawData() + (y * width + x) * 4);
+        case PixelFormat::RGBA16F:
+            return unpack_rgba16f(rgba16.getRawData() + (y * width + x) * 4);
+        case PixelFormat::RGBA32F:
+            break;
+        }
+        return rgba32.value_at(y,x);
+    }
+
+    // Packs the colour once and fills the storage with it
+    void Fill(const RGBAColor &color)
+    {
+        FillRect(0, 0, height, width, color);
+    }
+
+    void FillRect(int y0, int x0, int y1, int x1, const RGBAColor &color)
+    {
+        switch(format) {
+        case PixelFormat::RGBA8_SRGB: {
+            uchar packed[4];
+            pack_rgba8(color, packed);
+            fill_packed(rgba8, packed, y0, x0, y1, x1);
+            break;
+        }
+        case PixelFormat::RGBA16F: {
+            uint16_t packed[4];
+            pack_rgba16f(color, packed);
+            fill_packed(rgba16, packed, y0, x0, y1, x1);
+            break;
+        }
+        case PixelFormat::RGBA32F:
+            rgba32.FillRect(y0, x0, y1, x1, color);
+            break;
+        }
+    }
+
+    // Copies a rectangle from a buffer of the same size and format
+    void CopyRect(const ColorBuffer &src, int y0, int x0, int y1, int x1)
+    {
+        switch(format) {
+        case PixelFormat::RGBA8_SRGB:
+            rgba8.CopyRect(src.rgba8, y0, x0, y1, x1);
+            break;
+        case PixelFormat::RGBA16F:
+            rgba16.CopyRect(src.rgba16, y0, x0, y1, x1);
+            break;
+        case PixelFormat::RGBA32F:
+            rgba32.CopyRect(src.rgba32, y0, x0, y1, x1);
+            break;
+        }
+    }
+
+    // Unpacks row y into `width` RGBA floats
+    void loadRow(int y, float *dst) const
+    {
+        switch(format) {
+        case PixelFormat::RGBA8_SRGB:
+            decode_srgb_row(rgba8.getRawData() + size_t(y) * width * 4, dst, width, 4);
+            break;
+        case PixelFormat::RGBA16F:
+            half_to_float_row(rgba16.getRawData() + size_t(y) * width * 4, dst, width * 4);
+            break;
+        case PixelFormat::RGBA32F:
+            std::copy_n(rgba32_row(y), width * 4, dst);
+            break;
+        }
+    }
+
+    // Gamma encodes row y into 3 or 4 channel bytes. `scratch` must hold
+    // a row of RGBA floats, it is only used by RGBA16F buffers.
+    void encodeRow(int y, uchar *dst, int channels, Dither dither, float *scratch) const
+    {
+        encodeSpan(y, 0, width, dst, channels, dither, scratch);
+    }
+
+    // Same for the pixels [x0, x1) of row y, dst receives pixel x0
+    void encodeSpan(int y, int x0, int x1, uchar *dst, int channels, Dither dither,
+                    float *scratch) const
+    {
+        int count = x1 - x0;
+        size_t offset = size_t(y) * width + x0;
+        switch(format) {
+        case PixelFormat::RGBA8_SRGB:
+            copy_rgba8(rgba8.getRawData() + offset * 4, dst, count, channels);
+            break;
+        case PixelFormat::RGBA16F:
+            half_to_float_row(rgba16.getRawData() + offset * 4, scratch, count * 4);
+            encode_srgb_row(scratch, dst, count, channels, dither, y, x0);
+            break;
+        case PixelFormat::RGBA32F:
+            encode_srgb_row(rgba32_row(y) + size_t(x0) * 4, dst, count, channels, dither, y, x0);
+            break;
+        }
+    }
+
+    // Unpacks the whole buffer into a float image of the same size
+    void toRGBA(RGBAImage &dst) const
+    {
+        #pragma omp parallel for
+        for(int y = 0; y < height; y++) {
+            loadRow(y, reinterpret_cast<float*>(&dst(y,0)));
+        }
+    }
+
+    // Writes gamma encoded bytes of rows [y0, y1) with 3 or 4 channels per
+    // pixel, row y0 goes to dst and rows are `pitch` bytes apart.
+    // RGBA8_SRGB is a plain copy.
+    void encodeRows(int y0, int y1, uchar *dst, int pitch, int channels,
+                    Dither dither = Dither::None) const
+    {
+        #pragma omp parallel
+        {
+            std::vector<float> scratch(format == PixelFormat::RGBA16F ? width * 4 : 0);
+
+            #pragma omp for
+            for(int y = y0; y < y1; y++) {
+                encodeRow(y, dst + size_t(y - y0) * pitch, channels, dither, scratch.data());
+            }
+        }
+    }
+
+    // Encodes the rectangle [y0, y1) x [x0, x1), pixel (y0, x0) goes to dst.
+    // The dither pattern stays aligned to the whole buffer.
+    void encodeRect(int y0, int x0, int y1, int x1, uchar *dst, int pitch, int channels,
+                    Dither dither = Dither::None) const
+    {
+        #pragma omp parallel
+        {
+            std::vector<float> scratch(format == PixelFormat::RGBA16F ? (x1 - x0) * 4 : 0);
+
+            #pragma omp for
+            for(int y = y0; y < y1; y++) {
+                encodeSpan(y, x0, x1, dst + size_t(y - y0) * pitch, channels, dither,
+                           scratch.data());
+            }
+        }
+    }
+
+    void toSRGB(uchar *dst, int pitch, int channels,
+                Dither dither = Dither::None) const
+    {
+        encodeRows(0, height, dst, pitch, channels, dither);
+    }
+
+    // Direct access to the storage of RGBA32F buffers
+    RGBAImage &getRGBA() { return rgba32; }
+    const uchar* getRawData() const
+    {
+        switch(format) {
+        case PixelFormat::RGBA8_SRGB:
+            return rgba8.getRawData();
+        case PixelFormat::RGBA16F:
+            return reinterpret_cast<const uchar*>(rgba16.getRawData());
+        case PixelFormat::RGBA32F:
+            break;
+        }
+        return reinterpret_cast<const uchar*>(rgba32.getRawData());
+    }
+
+private:
+    int storage_width(PixelFormat f) const { return f == format ? width : 0; }
+
+    const float* rgba32_row(int y) const
+    {
+        return reinterpret_cast<const float*>(rgba32.getRawData() + size_t(y) * width);
+    }
+
+    static void copy_rgba8(const uchar *src, uchar *dst, int count, int channels)
+    {
+        if(channels == 4) {
+            std::memcpy(dst, src, size_t(count) * 4);
+            return;
+        }
+        for(int x = 0; x < count; x++) {
+            for(int c = 0; c < channels; c++) {
+                dst[x * channels + c] = src[x * 4 + c];
+            }
+        }
+    }
+
+    template<typename T>
+    void fill_packed(Array3D<T> &buf, const T *packed, int y0, int x0, int y1, int x1)
+    {
+        for(int y = y0; y < y1; y++) {
+            T *row = &buf(y, 0);
+            for(int x = x0; x < x1; x++) {
+                for(int c = 0; c < 4; c++) {
+                    row[x * 4 + c] = packed[c];
+                }
+            }
+        }
+    }
+};
+
 using DepthMap = RenderBuffer<float, 1>;
 using StencilMap = RenderBuffer<uchar, 1>;
 using NormalMap = RenderBuffer<tmath::Vec3, 1>;
-// Convert rgba image to srgb
-SRGBImage image_a2s(const RGBAImage &src);
+// Convert rgba image to srgb. Clamps and applies the sRGB curve,
+// rows are converted in parallel.
+SRGBImage image_a2s(const RGBAImage &src, Dither dither = Dither::None);
+
+// Same, but into an existing image which is resized if needed
+void image_a2s(const RGBAImage &src, SRGBImage &dst, Dither dither = Dither::None);
 
-// Convert srgb image to rgba
+// Same, but into a caller provided buffer with 3 or 4 channels per pixel
+void image_a2s(const RGBAImage &src, uchar *dst, int pitch, int channels,
+               Dither dither = Dither::None);
+
+// Convert srgb image to rgba (linear, alpha = 1)
 RGBAImage image_s2a(const SRGBImage &src);
 
+void image_s2a(const SRGBImage &src, RGBAImage &dst);
+
 void save_image(const SRGBImage &img, const std::string &filename);
 
 #endif
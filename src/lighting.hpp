@@ -37,39 +37,61 @@ struct PointLight
 
 using FullscreenShader = std::function<void(Framebuffer&, Framebuffer&, UniformVec&)>;
 
-void phong(const PointLight &light, const Vec3 &cam_pos, Framebuffer &input, Framebuffer &output)
+// Lights a single G-buffer sample. `visibility` is the fraction of the
+// light reaching it, the ambient term stays.
+inline RGBAColor phong_shade(const PointLight &light, const Vec3 &cam_pos,
+                             const Vec3 &pos, const Vec3 &normal, const RGBAColor &color,
+                             float visibility = 1.0f)
 {
-    int w = input.getWidth();
-    int h = input.getHeight();
+    Vec3 light_dir = normalize(pos - light.pos);
+    Vec3 view_dir = normalize(pos - cam_pos);
+    Vec3 r = reflect(light_dir, normal);
 
+    float falloff = length(pos - light.pos) / light.strength;
+    falloff = 1.0f - std::min(falloff, 1.0f);
+    falloff = falloff * falloff;
+    float energy = dot(-light_dir, normal);
+    float spec = pow(dot(-view_dir, r), 20);
+    energy = std::min(energy + spec, 1.0f) * visibility;
+    energy = std::max(energy, 0.2f);
+    energy *= falloff;
+    Vec4 res_color = energy * color;
+    res_color[3] = 1.0f;
+    return res_color;
+}
+
+// `visibility(pos, normal)` gives the fraction of the light reaching pos,
+// see ShadowCubeMap::visibility
+template<typename FB, typename Visibility>
+void phong(const PointLight &light, const Vec3 &cam_pos, FB &input, FB &output,
+           const Visibility &visibility)
+{
     auto &attrs = input.getAttribs();
-    auto &depth = input.getDepth();
-    auto &stencil = input.getStencil();
-    auto &image = input.getImage();
-    for(int y = 0; y < h; y++) {
-        for(int x = 0; x < w; x++) {
-            if(!stencil(y,x)) continue;
+    const TileGrid &tiles = input.getTiles();
 
-            auto &cur_attr = attrs(y,x);
-            Vec3 light_dir = normalize(cur_attr.pos - light.pos);
-            Vec3 view_dir = normalize(cur_attr.pos - cam_pos);
-            Vec3 r = reflect(light_dir, cur_attr.normal);
+    #pragma omp parallel for schedule(dynamic)
+    for(int t = 0; t < tiles.numTiles(); t++) {
+        if(input.tileUntouched(t)) continue;
 
-            float falloff = length(cur_attr.pos - light.pos) / light.strength;
-            falloff = 1.0f - std::min(falloff, 1.0f);
-            falloff = falloff * falloff;
-            float energy = dot(-light_dir, cur_attr.normal);
-            float spec = pow(dot(-view_dir, r), 20);
-            energy = std::min(energy + spec, 1.0f);
-            energy = std::max(energy, 0.2f);
-            energy *= falloff;
-            const auto &color = image.getPixel(x,y);
-            Vec4 res_color = energy * color;
-            res_color[3] = 1.0f;
-            output.putPixel(x,y,depth(y,x), res_color);
+        TileRect rect = tiles.rect(t);
+        for(int y = rect.y0; y < rect.y1; y++) {
+            for(int x = rect.x0; x < rect.x1; x++) {
+                if(!input.getStencilValue(x,y)) continue;
+
+                auto &cur_attr = attrs(y,x);
+                RGBAColor res_color = phong_shade(light, cam_pos, cur_attr.pos,
+                                                  cur_attr.normal, input.getPixel(x,y),
+                                                  visibility(cur_attr.pos, cur_attr.normal));
+                output.putPixel(x,y,input.getDepthValue(x,y), res_color);
+            }
         }
     }
 }
 
+template<typename FB>
+void phong(const PointLight &light, const Vec3 &cam_pos, FB &input, FB &output)
+{
+    phong(light, cam_pos, input, output, [](const Vec3&, const Vec3&) { return 1.0f; });
+}
 
 #endif
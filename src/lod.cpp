@@ -0,0 +1,360 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  lod.cpp
+ *
+ *    Description:  Quadric error simplification and level of detail selection
+ *
+ *        Version:  1.0
+ *        Created:  23.10.2026 18:31:44
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "lod.hpp"
+
+#include <cmath>
+#include <queue>
+#include <limits>
+#include <tuple>
+#include <numeric>
+#include <algorithm>
+
+// Boundary planes count this much more than surface ones
+const double BOUNDARY_WEIGHT = 10.0;
+
+// Symmetric 4x4 matrix of the weighted sum of squared distances to a
+// set of planes, and the sum of the weights
+struct Quadric
+{
+    double xx = 0, xy = 0, xz = 0, xw = 0;
+    double yy = 0, yz = 0, yw = 0;
+    double zz = 0, zw = 0;
+    double ww = 0;
+    double weight = 0;
+
+    Quadric() { }
+
+    // Plane n.p + d = 0 with unit n
+    Quadric(double nx, double ny, double nz, double d, double weight) :
+        xx(weight * nx * nx), xy(weight * nx * ny), xz(weight * nx * nz), xw(weight * nx * d),
+        yy(weight * ny * ny), yz(weight * ny * nz), yw(weight * ny * d),
+        zz(weight * nz * nz), zw(weight * nz * d),
+        ww(weight * d * d), weight(weight)
+    { }
+
+    Quadric& operator+=(const Quadric &q)
+    {
+        xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw;
+        yy += q.yy; yz += q.yz; yw += q.yw;
+        zz += q.zz; zw += q.zw;
+        ww += q.ww;
+        weight += q.weight;
+        return *this;
+    }
+
+    // Mean squared distance
+    double eval(const float *p) const
+    {
+        double x = p[0], y = p[1], z = p[2];
+        double sum = xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x +
+                     yy * y * y + 2 * yz * y * z + 2 * yw * y +
+                     zz * z * z + 2 * zw * z + ww;
+        return weight > 0.0 ? std::max(0.0, sum / weight) : 0.0;
+    }
+};
+
+static Quadric plane_quadric(const float *n, const float *p, double weight)
+{
+    return Quadric(n[0], n[1], n[2], -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]), weight);
+}
+
+// Unnormalized normal of the triangle abc, plain floats in the hot loop
+static inline void tri_normal(const float *a, const float *b, const float *c, float *n)
+{
+    float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+struct Collapse
+{
+    float cost;
+    uint32_t from, to;
+    uint32_t from_version, to_version;
+
+    bool operator<(const Collapse &c) const { return cost > c.cost; }
+};
+
+float simplify(const std::vector<uint32_t> &indices, const VertexBuffer &vertices,
+               size_t target_triangles, std::vector<uint32_t> &out)
+{
+    size_t num_vertices = vertices.size();
+    size_t num_tris = indices.size() / 3;
+    out = indices;
+    if(num_tris <= target_triangles) return 0.0f;
+
+    auto pos = [&vertices](uint32_t v) { return vertices.vertex(v); };
+
+    // Seams: several vertices at one position can not move apart
+    std::vector<uint8_t> locked(num_vertices, 0);
+    {
+        std::vector<uint32_t> sorted(num_vertices);
+        std::iota(sorted.begin(), sorted.end(), 0);
+        auto less = [&pos](uint32_t a, uint32_t b) {
+            const float *p = pos(a), *q = pos(b);
+            return std::tie(p[0], p[1], p[2]) < std::tie(q[0], q[1], q[2]);
+        };
+        std::sort(sorted.begin(), sorted.end(), less);
+        for(size_t i = 1; i < num_vertices; i++) {
+            if(less(sorted[i - 1], sorted[i])) continue;
+            locked[sorted[i - 1]] = 1;
+            locked[sorted[i]] = 1;
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> vertex_tris(num_vertices);
+    for(size_t i = 0; i < out.size(); i++) vertex_tris[out[i]].push_back(i / 3);
+
+    // An edge is open if only one triangle of its first vertex has both
+    auto open_edge = [&](uint32_t a, uint32_t b) {
+        int count = 0;
+        for(uint32_t t : vertex_tris[a]) {
+            const uint32_t *tri = &out[t * 3];
+            count += tri[0] == b or tri[1] == b or tri[2] == b;
+        }
+        return count == 1;
+    };
+
+    // Area weighted face planes, and planes through open edges at right
+    // angles to their face
+    std::vector<Quadric> quadrics(num_vertices);
+    std::vector<uint8_t> open(num_tris * 3, 0);
+    for(size_t t = 0; t < num_tris; t++) {
+        const uint32_t *tri = &out[t * 3];
+        float n[3];
+        tri_normal(pos(tri[0]), pos(tri[1]), pos(tri[2]), n);
+        float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if(len <= 0.0f) continue;
+        for(int c = 0; c < 3; c++) n[c] /= len;
+        Quadric q = plane_quadric(n, pos(tri[0]), len * 0.5);
+        for(int k = 0; k < 3; k++) quadrics[tri[k]] += q;
+
+        for(int k = 0; k < 3; k++) {
+            uint32_t a = tri[k], b = tri[(k + 1) % 3];
+            if(!open_edge(a, b)) continue;
+            open[t * 3 + k] = 1;
+            // Normal of the plane through the edge and n
+            const float *pa = pos(a), *pb = pos(b);
+            float e[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+            float side[3] = { e[1] * n[2] - e[2] * n[1],
+                              e[2] * n[0] - e[0] * n[2],
+                              e[0] * n[1] - e[1] * n[0] };
+            float side_len = std::sqrt(side[0] * side[0] + side[1] * side[1] + side[2] * side[2]);
+            if(side_len <= 0.0f) continue;
+            for(int c = 0; c < 3; c++) side[c] /= side_len;
+            float edge_len2 = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+            Quadric qb = plane_quadric(side, pa, BOUNDARY_WEIGHT * edge_len2);
+            quadrics[a] += qb;
+            quadrics[b] += qb;
+        }
+    }
+
+    std::vector<uint32_t> version(num_vertices, 0);
+    std::vector<uint8_t> removed(num_vertices, 0);
+    std::vector<uint8_t> alive(num_tris, 1);
+    std::priority_queue<Collapse> heap;
+
+    auto collapse = [&](uint32_t from, uint32_t to) {
+        Quadric q = quadrics[from];
+        q += quadrics[to];
+        return Collapse({float(q.eval(pos(to))), from, to, version[from], version[to]});
+    };
+    auto push = [&](uint32_t from, uint32_t to) {
+        if(!locked[from]) heap.push(collapse(from, to));
+    };
+
+    // Every inner edge shows up once in each direction, open ones once
+    {
+        std::vector<Collapse> initial;
+        initial.reserve(num_tris * 3);
+        for(size_t t = 0; t < num_tris; t++) {
+            for(int k = 0; k < 3; k++) {
+                uint32_t a = out[t * 3 + k], b = out[t * 3 + (k + 1) % 3];
+                if(!locked[a]) initial.push_back(collapse(a, b));
+                if(open[t * 3 + k] and !locked[b]) initial.push_back(collapse(b, a));
+            }
+        }
+        heap = std::priority_queue<Collapse>(std::less<Collapse>(), std::move(initial));
+    }
+
+    size_t live = num_tris;
+    float max_cost = 0.0f;
+    std::vector<uint32_t> neighbours;
+    while(live > target_triangles and !heap.empty()) {
+        Collapse c = heap.top();
+        heap.pop();
+        uint32_t u = c.from, v = c.to;
+        if(removed[u] or removed[v]) continue;
+        if(c.from_version != version[u] or c.to_version != version[v]) continue;
+
+        // Moving u onto v must not turn any remaining triangle over
+        bool flips = false;
+        for(uint32_t t : vertex_tris[u]) {
+            if(!alive[t]) continue;
+            const uint32_t *tri = &out[t * 3];
+            if(tri[0] == v or tri[1] == v or tri[2] == v) continue;
+            const float *p[3], *q[3];
+            for(int k = 0; k < 3; k++) {
+                p[k] = vertices.vertex(tri[k]);
+                q[k] = tri[k] == u ? vertices.vertex(v) : p[k];
+            }
+            float n0[3], n1[3];
+            tri_normal(p[0], p[1], p[2], n0);
+            tri_normal(q[0], q[1], q[2], n1);
+            if(n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0f) {
+                flips = true;
+                break;
+            }
+        }
+        if(flips) continue;
+
+        for(uint32_t t : vertex_tris[u]) {
+            if(!alive[t]) continue;
+            uint32_t *tri = &out[t * 3];
+            if(tri[0] == v or tri[1] == v or tri[2] == v) {
+                alive[t] = 0;
+                live--;
+                continue;
+            }
+            for(int k = 0; k < 3; k++) {
+                if(tri[k] == u) tri[k] = v;
+            }
+            vertex_tris[v].push_back(t);
+        }
+        vertex_tris[u].clear();
+        removed[u] = 1;
+        quadrics[v] += quadrics[u];
+        version[v]++;
+        max_cost = std::max(max_cost, c.cost);
+
+        // Costs around v changed, drop its dead triangles on the way
+        auto &tris = vertex_tris[v];
+        tris.erase(std::remove_if(tris.begin(), tris.end(),
+                                  [&alive](uint32_t t) { return !alive[t]; }),
+                   tris.end());
+        neighbours.clear();
+        for(uint32_t t : tris) {
+            for(int k = 0; k < 3; k++) {
+                uint32_t w = out[t * 3 + k];
+                if(w != v) neighbours.push_back(w);
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        for(uint32_t w : neighbours) {
+            push(v, w);
+            push(w, v);
+        }
+    }
+
+    size_t n = 0;
+    for(size_t t = 0; t < num_tris; t++) {
+        if(!alive[t]) continue;
+        for(int k = 0; k < 3; k++) out[n * 3 + k] = out[t * 3 + k];
+        n++;
+    }
+    out.resize(n * 3);
+    return std::sqrt(max_cost);
+}
+
+void build_lods(Model &model, int max_levels, float ratio)
+{
+    LODChain &chain = model.lods;
+    chain.levels.clear();
+
+    const VertexBuffer &vb = model.vertices;
+    Vec3 lo({ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+              std::numeric_limits<float>::max() });
+    Vec3 hi = -1.0f * lo;
+    for(size_t i = 0; i < vb.size(); i++) {
+        for(int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], vb.vertex(i)[c]);
+            hi[c] = std::max(hi[c], vb.vertex(i)[c]);
+        }
+    }
+    chain.center = (lo + hi) * 0.5f;
+    chain.radius = 0.0f;
+    for(size_t i = 0; i < vb.size(); i++) {
+        const float *p = vb.vertex(i);
+        chain.radius = std::max(chain.radius,
+                                tmath::length(Vec3({p[0], p[1], p[2]}) - chain.center));
+    }
+
+    std::vector<uint32_t> current(model.indices.size()), next;
+    for(size_t i = 0; i < current.size(); i++) current[i] = model.indices[i];
+
+    // Each level starts from the one before, so errors add up
+    float error = 0.0f;
+    for(int level = 0; level < max_levels; level++) {
+        size_t tris = current.size() / 3;
+        if(tris <= LOD_MIN_TRIANGLES) break;
+        size_t target = std::max(LOD_MIN_TRIANGLES, size_t(tris * ratio));
+        float level_error = simplify(current, vb, target, next);
+        if(next.size() / 3 > tris - tris / 10) break;
+        if(error + level_error > LOD_MAX_ERROR * chain.radius) break;
+        error += level_error;
+
+        chain.levels.push_back({IndexBuffer(next, model.indices.getType() == IndexType::U16),
+                                error});
+        current.swap(next);
+    }
+}
+
+int select_lod(const Model &model, const tmath::Mat4 &model_to_clip, int screen_height,
+               float max_pixel_error)
+{
+    const LODChain &chain = model.lods;
+    if(chain.levels.empty()) return 0;
+
+    // For perspective() * rigid view * uniform scale s, row 1 is
+    // P(1,1) * s * the view up axis and row 3 s * the view direction,
+    // so their lengths give the pixel scale and the model scale
+    Vec3 row1({model_to_clip(1,0), model_to_clip(1,1), model_to_clip(1,2)});
+    Vec3 row3({model_to_clip(3,0), model_to_clip(3,1), model_to_clip(3,2)});
+    float pixels_per_unit = tmath::length(row1) * 0.5f * screen_height;
+    float scale = tmath::length(row3);
+
+    float w = tmath::dot(row3, chain.center) + model_to_clip(3,3);
+    float distance = scale > 0.0f ? w - chain.radius * scale : w;
+    if(distance <= 0.0f) return 0;
+
+    int best = 0;
+    for(size_t i = 0; i < chain.levels.size(); i++) {
+        if(chain.levels[i].error * pixels_per_unit / distance > max_pixel_error) break;
+        best = i + 1;
+    }
+    return best;
+}
+
+Model lod_view(const Model &model, int level)
+{
+    Model view;
+    const VertexBuffer &vb = model.vertices;
+    view.vertices = VertexBuffer::view(vb.getLayout(), vb.getRawData(), vb.size());
+    const IndexBuffer &ib = level > 0 ? model.lods.levels[level - 1].indices : model.indices;
+    if(ib.getType() == IndexType::U16) {
+        view.indices = IndexBuffer::view(static_cast<const uint16_t*>(ib.getRawData()), ib.size());
+    } else {
+        view.indices = IndexBuffer::view(static_cast<const uint32_t*>(ib.getRawData()), ib.size());
+    }
+    if(level == 0) view.meshlets = model.meshlets;
+    return view;
+}
@@ -0,0 +1,59 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  lod.hpp
+ *
+ *    Description:  Quadric error simplification and level of detail selection
+ *
+ *        Version:  1.0
+ *        Created:  23.10.2026 18:31:44
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef LOD_HPP
+#define LOD_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include "model.hpp"
+#include "math/matrix.hpp"
+
+const int LOD_MAX_LEVELS = 8;
+const size_t LOD_MIN_TRIANGLES = 64;
+// Levels stop before deviating this much relative to the bounding radius
+const float LOD_MAX_ERROR = 0.1f;
+
+// Edge collapses ordered by quadric error (Garland, Heckbert 1997) until at
+// most `target_triangles` remain. Vertices only move onto existing ones,
+// so the result indexes the same vertex buffer. Vertices that share a
+// position with another (attribute seams) stay, open boundaries are held
+// by extra planes. Returns the error: the largest RMS distance of a
+// collapsed vertex to the planes it gathered, in model units.
+// Attribute 0 must be the Vec3 position.
+float simplify(const std::vector<uint32_t> &indices, const VertexBuffer &vertices,
+               size_t target_triangles, std::vector<uint32_t> &out);
+
+// Fills model.lods, each level with about `ratio` of the triangles of
+// the one before, until `max_levels`, simplification stalls or the
+// error passes LOD_MAX_ERROR
+void build_lods(Model &model, int max_levels = LOD_MAX_LEVELS, float ratio = 0.5f);
+
+// Coarsest level whose error projects to at most `max_pixel_error` pixels
+// on a screen `screen_height` pixels high. Level 0 is the model itself.
+// Reads the projection scale and the view distance from the rows of
+// `model_to_clip` (perspective() * view * model), exact for rigid views
+// and uniform scaling.
+int select_lod(const Model &model, const tmath::Mat4 &model_to_clip, int screen_height,
+               float max_pixel_error = 1.0f);
+
+// The model's vertices with the triangles of `level`, viewing both
+Model lod_view(const Model &model, int level);
+
+#endif
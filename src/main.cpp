@@ -29,6 +29,7 @@
 #include "ray_marching.hpp"
 #include "lighting.hpp"
 #include "sdf.hpp"
+#include "frame_writer.hpp"
 using tmath::Vec3;
 using tmath::Vec4;
 using tmath::Mat4;
@@ -57,10 +58,11 @@ Vec4 fsh(const AttribVec &inp, const UniformVec &unis)
 Model create_triangle(const std::array<Vec3, 3> &points)
 {
     Model m;
-    m.indeces = { {0,1,2} };
-    m.v_attrs.push_back({ points[0], Vec3({1.0 ,0.0, 0.0}) });
-    m.v_attrs.push_back({ points[1], Vec3({0.0 ,1.0, 0.0}) });
-    m.v_attrs.push_back({ points[2], Vec3({0.0 ,0.0, 1.0}) });
+    m.vertices = VertexBuffer({ AttribType::Vec3, AttribType::Vec3 });
+    m.indices = { 0, 1, 2 };
+    m.vertices.push({ points[0], Vec3({1.0 ,0.0, 0.0}) });
+    m.vertices.push({ points[1], Vec3({0.0 ,1.0, 0.0}) });
+    m.vertices.push({ points[2], Vec3({0.0 ,0.0, 1.0}) });
     return m;
 }
 
@@ -125,6 +127,9 @@ int main()
     light.pos = light_pos;
     light.strength = 45;
 
+    FramebufferPool targets;
+    FrameWriter writer;
+
 //    for(int i = 0; i < num_frames; i++) {
     int i = 75;
     fb.clearAll(RGBAColor({0,0,0,1}));
@@ -136,42 +141,48 @@ int main()
         light.pos = cam_pos;
         trace(fb, trace_f, cam_fov, cam_pos, cam_dir);
 
-        auto fb2 = fb_like(fb);
-        phong(light, cam_pos, fb, fb2);
+        auto fb2 = targets.acquireLike(fb);
+        phong(light, cam_pos, fb, *fb2);
 
         std::ostringstream ss;
         ss << "img/" << std::setw(5) << std::setfill('0');
         ss  << "4k.png";
 
         std::string filename = ss.str();
-        fb2.Save(filename);
+        writer.submit(fb2->getImage(), filename);
 
-        std::cout << filename << " saved!\n";
+        std::cout << filename << " queued\n";
 
     //}
 
+    if(writer.flush()) {
+        std::cout << "All frames saved\n";
+    }
+
     return 0;
 
     Display dis(3840, 2160, "Main window");
-    while(true) {
-        SDL_PumpEvents();
-        SDL_Event e;
-        if (SDL_PollEvent(&e)) {
-            if (e.type == SDL_QUIT) {
-                break;
-            }
-        }
+    Presenter presenter(dis, 3840, 2160, 3);
+    FrameArenas arenas;
+    // Only new highs are logged, not every frame
+    arenas.setPeakHook([max_peak = size_t(0)](const FrameArenaStats &s) mutable {
+        if(s.peak <= max_peak) return;
+        max_peak = s.peak;
+        std::cout << "Frame arena peak: " << s.peak << " bytes\n";
+    });
+    while(!presenter.shouldQuit()) {
+        ArenaScope frame_scope(arenas.local());
         //Mat4 rot = tmath::rotation(angle, Vec3({0,1,0}));
         ///model_transform = translate * rot;
         //angle += 0.05;
         RGBAColor clear({0,0,0,1});
-        dis.getFBO().clearAll(clear);
+        Framebuffer &target = presenter.beginFrame();
+        target.clearAll(clear);
         //UniformVec unis = { model_transform, proj };
-        //draw_model(tri, sh, dis.getFBO(), unis);
-        dis.Update();
+        //draw_model(tri, sh, target, unis);
+        presenter.endFrame();
         frame++;
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        arenas.endFrame();
     }
 
     return 0;
@@ -40,12 +40,14 @@ public:
     float operator() (unsigned i, unsigned j) const { return rows[i][j]; }
 
 
-    Matrix& operator=(Matrix& other) {
+    Matrix& operator=(const Matrix& other) {
         rows = other.rows;
+        return *this;
     }
 
     Matrix& operator=(Matrix&& other) {
         rows = std::move(other.rows);
+        return *this;
     }
 
     Vector<N> column(unsigned j) const {
@@ -55,6 +55,26 @@ inline Mat4 perspective(float hfov, float aspect, float near, float far)
     return m;
 }
 
+// Inverse of a matrix whose last row is (0, 0, 0, 1)
+inline Mat4 affine_inverse(const Mat4 &m)
+{
+    float a = m(0,0), b = m(0,1), c = m(0,2);
+    float d = m(1,0), e = m(1,1), f = m(1,2);
+    float g = m(2,0), h = m(2,1), i = m(2,2);
+    float det = a * (e*i - f*h) - b * (d*i - f*g) + c * (d*h - e*g);
+    float s = det != 0.0f ? 1.0f / det : 0.0f;
+
+    Mat4 res;
+    res(0,0) = (e*i - f*h) * s;  res(0,1) = (c*h - b*i) * s;  res(0,2) = (b*f - c*e) * s;
+    res(1,0) = (f*g - d*i) * s;  res(1,1) = (a*i - c*g) * s;  res(1,2) = (c*d - a*f) * s;
+    res(2,0) = (d*h - e*g) * s;  res(2,1) = (b*g - a*h) * s;  res(2,2) = (a*e - b*d) * s;
+    for(int r = 0; r < 3; r++) {
+        res(r,3) = -(res(r,0) * m(0,3) + res(r,1) * m(1,3) + res(r,2) * m(2,3));
+    }
+    res(3,3) = 1.0f;
+    return res;
+}
+
 }
 
 #endif
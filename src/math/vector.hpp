@@ -65,14 +65,16 @@ public:
         value(std::move(other.value))
     { }
 
-    Vector& operator= (Vector& other)
+    Vector& operator= (const Vector& other)
     {
         value = other.value;
+        return *this;
     }
 
     Vector& operator= (Vector&& other)
     {
         value = std::move(other.value);
+        return *this;
     }
 
     float& operator[] (int idx)
@@ -0,0 +1,823 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  mesh_io.cpp
+ *
+ *    Description:  OBJ/PLY import and a native binary mesh format
+ *
+ *        Version:  1.0
+ *        Created:  22.10.2026 13:48:02
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "mesh_io.hpp"
+#include "mesh_opt.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <unordered_map>
+
+#include <omp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+static const char MESH_MAGIC[4] = { 'T', 'G', 'M', 'S' };
+static const uint64_t MESH_ALIGN = 64;
+
+// Read-only mapping of a whole file
+struct FileMapping
+{
+    const char *data = nullptr;
+    size_t size = 0;
+
+    FileMapping(const std::string &filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        struct stat st;
+        if(fd < 0 or fstat(fd, &st) != 0 or st.st_size == 0) {
+            if(fd >= 0) close(fd);
+            return;
+        }
+        void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(ptr == MAP_FAILED) return;
+        data = static_cast<const char*>(ptr);
+        size = st.st_size;
+        madvise(ptr, size, MADV_SEQUENTIAL);
+    }
+
+    ~FileMapping()
+    {
+        if(data) munmap(const_cast<char*>(data), size);
+    }
+
+    const char* end() const { return data + size; }
+};
+
+static bool fail(const std::string &filename, const std::string &what)
+{
+    std::cout << "Can't import " << filename << ": " << what << std::endl;
+    return false;
+}
+
+static inline const char* skip_blanks(const char *p, const char *end)
+{
+    while(p < end and (*p == ' ' or *p == '\t' or *p == '\r')) p++;
+    return p;
+}
+
+static inline const char* next_line(const char *p, const char *end)
+{
+    const char *nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return nl ? nl + 1 : end;
+}
+
+static inline const char* parse_float(const char *p, const char *end, float &v)
+{
+    p = skip_blanks(p, end);
+    if(p < end and *p == '+') p++;
+    auto res = std::from_chars(p, end, v);
+    return res.ec == std::errc() ? res.ptr : nullptr;
+}
+
+// Fills a model from positions, optional normals and triangle corners
+// that index both. Identical corners share a vertex.
+static void build_model(const std::vector<float> &pos, const std::vector<float> &norm,
+                        const std::vector<int64_t> &corner_v,
+                        const std::vector<int64_t> &corner_n, Model &model)
+{
+    size_t num_corners = corner_v.size();
+    std::vector<uint32_t> indices(num_corners);
+
+    if(norm.empty()) {
+        model.vertices = VertexBuffer({ AttribType::Vec3 }, std::vector<float>(pos));
+        std::copy(corner_v.begin(), corner_v.end(), indices.begin());
+        model.indices = IndexBuffer(indices);
+        return;
+    }
+
+    VertexLayout layout({ AttribType::Vec3, AttribType::Vec3 });
+    std::vector<float> values;
+
+    bool same = pos.size() == norm.size();
+    #pragma omp parallel for reduction(&&:same)
+    for(size_t i = 0; i < num_corners; i++) {
+        same = same and corner_n[i] == corner_v[i];
+    }
+
+    if(same) {
+        // Normal i belongs to position i, as most exporters write it
+        size_t n = pos.size() / 3;
+        values.resize(n * 6);
+        #pragma omp parallel for
+        for(size_t i = 0; i < n; i++) {
+            std::memcpy(&values[i * 6], &pos[i * 3], 3 * sizeof(float));
+            std::memcpy(&values[i * 6 + 3], &norm[i * 3], 3 * sizeof(float));
+        }
+        std::copy(corner_v.begin(), corner_v.end(), indices.begin());
+    } else {
+        std::unordered_map<uint64_t, uint32_t> unique;
+        unique.reserve(pos.size() / 3);
+        for(size_t i = 0; i < num_corners; i++) {
+            uint64_t key = (uint64_t(corner_v[i]) << 32) | uint32_t(corner_n[i] + 1);
+            auto it = unique.emplace(key, uint32_t(values.size() / 6));
+            if(it.second) {
+                const float *p = &pos[corner_v[i] * 3];
+                values.insert(values.end(), p, p + 3);
+                if(corner_n[i] >= 0) {
+                    const float *n = &norm[corner_n[i] * 3];
+                    values.insert(values.end(), n, n + 3);
+                } else {
+                    values.insert(values.end(), 3, 0.0f);
+                }
+            }
+            indices[i] = it.first->second;
+        }
+    }
+
+    model.vertices = VertexBuffer(layout, std::move(values));
+    model.indices = IndexBuffer(indices);
+}
+
+/* OBJ */
+
+struct ObjChunk
+{
+    std::vector<float> pos, norm;
+    // Triangulated corners. Negative OBJ indices are stored relative to
+    // the chunk start and flagged, they are resolved once all chunks are
+    // counted.
+    std::vector<int64_t> corner_v, corner_n;
+    std::vector<uint8_t> relative;
+    bool ok = true;
+};
+
+enum ObjRelative : uint8_t {
+    REL_V = 1,
+    REL_N = 2
+};
+
+static void parse_obj_chunk(const char *p, const char *end, ObjChunk &c)
+{
+    int64_t fan_v[3], fan_n[3];
+    uint8_t fan_rel[3];
+
+    while(p < end and c.ok) {
+        const char *line_end = next_line(p, end);
+        p = skip_blanks(p, line_end);
+
+        if(line_end - p > 2 and p[0] == 'v' and (p[1] == ' ' or p[1] == '\t')) {
+            float xyz[3];
+            const char *q = p + 2;
+            for(int i = 0; i < 3 and q; i++) q = parse_float(q, line_end, xyz[i]);
+            if(!q) { c.ok = false; break; }
+            c.pos.insert(c.pos.end(), xyz, xyz + 3);
+        } else if(line_end - p > 3 and p[0] == 'v' and p[1] == 'n') {
+            float xyz[3];
+            const char *q = p + 2;
+            for(int i = 0; i < 3 and q; i++) q = parse_float(q, line_end, xyz[i]);
+            if(!q) { c.ok = false; break; }
+            c.norm.insert(c.norm.end(), xyz, xyz + 3);
+        } else if(line_end - p > 2 and p[0] == 'f' and (p[1] == ' ' or p[1] == '\t')) {
+            const char *q = p + 2;
+            int corner = 0;
+            while(true) {
+                q = skip_blanks(q, line_end);
+                if(q == line_end or *q == '\n' or *q == '#') break;
+
+                int64_t idx[3] = { 0, 0, 0 };   // v/vt/vn, 0 = missing
+                for(int k = 0; k < 3; k++) {
+                    if(q < line_end and *q != '/') {
+                        auto res = std::from_chars(q, line_end, idx[k]);
+                        if(res.ec != std::errc() or idx[k] == 0) { c.ok = false; return; }
+                        q = res.ptr;
+                    }
+                    if(q < line_end and *q == '/') q++;
+                    else break;
+                }
+
+                int64_t v = idx[0], n = idx[2];
+                uint8_t rel = 0;
+                if(v < 0) { v += c.pos.size() / 3; rel |= REL_V; } else { v--; }
+                if(n < 0) { n += c.norm.size() / 3; rel |= REL_N; } else { n--; }
+
+                int slot = std::min(corner, 2);
+                fan_v[slot] = v; fan_n[slot] = n; fan_rel[slot] = rel;
+                if(corner >= 2) {
+                    for(int k = 0; k < 3; k++) {
+                        c.corner_v.push_back(fan_v[k]);
+                        c.corner_n.push_back(fan_n[k]);
+                        c.relative.push_back(fan_rel[k]);
+                    }
+                    // Next triangle of the fan shares corners 0 and 2
+                    fan_v[1] = fan_v[2]; fan_n[1] = fan_n[2]; fan_rel[1] = fan_rel[2];
+                }
+                corner++;
+            }
+        }
+        p = line_end;
+    }
+}
+
+bool import_obj(const std::string &filename, Model &model)
+{
+    FileMapping file(filename);
+    if(!file.data) return fail(filename, "can't read file");
+
+    // Split at line starts, several chunks per thread for balance
+    int num_chunks = std::max<size_t>(1, std::min<size_t>(omp_get_max_threads() * 4,
+                                                          file.size >> 16));
+    std::vector<const char*> bounds(num_chunks + 1);
+    bounds[0] = file.data;
+    bounds[num_chunks] = file.end();
+    for(int i = 1; i < num_chunks; i++) {
+        const char *guess = std::max(bounds[i - 1], file.data + file.size * i / num_chunks);
+        bounds[i] = guess == file.data ? guess : next_line(guess - 1, file.end());
+    }
+
+    std::vector<ObjChunk> chunks(num_chunks);
+    #pragma omp parallel for schedule(dynamic)
+    for(int i = 0; i < num_chunks; i++) {
+        parse_obj_chunk(bounds[i], bounds[i + 1], chunks[i]);
+    }
+
+    std::vector<size_t> pos_base(num_chunks + 1, 0);
+    std::vector<size_t> norm_base(num_chunks + 1, 0);
+    std::vector<size_t> corner_base(num_chunks + 1, 0);
+    for(int i = 0; i < num_chunks; i++) {
+        if(!chunks[i].ok) return fail(filename, "malformed line");
+        pos_base[i + 1] = pos_base[i] + chunks[i].pos.size();
+        norm_base[i + 1] = norm_base[i] + chunks[i].norm.size();
+        corner_base[i + 1] = corner_base[i] + chunks[i].corner_v.size();
+    }
+
+    std::vector<float> pos(pos_base[num_chunks]);
+    std::vector<float> norm(norm_base[num_chunks]);
+    std::vector<int64_t> corner_v(corner_base[num_chunks]);
+    std::vector<int64_t> corner_n(corner_base[num_chunks]);
+    int64_t num_pos = pos.size() / 3;
+    int64_t num_norm = norm.size() / 3;
+    bool in_range = true;
+
+    #pragma omp parallel for schedule(dynamic) reduction(&&:in_range)
+    for(int i = 0; i < num_chunks; i++) {
+        ObjChunk &c = chunks[i];
+        std::copy(c.pos.begin(), c.pos.end(), pos.begin() + pos_base[i]);
+        std::copy(c.norm.begin(), c.norm.end(), norm.begin() + norm_base[i]);
+
+        int64_t v_shift = pos_base[i] / 3;
+        int64_t n_shift = norm_base[i] / 3;
+        for(size_t k = 0; k < c.corner_v.size(); k++) {
+            int64_t v = c.corner_v[k] + (c.relative[k] & REL_V ? v_shift : 0);
+            int64_t n = c.corner_n[k];
+            // -1 marks a corner without a normal
+            if(n != -1 or (c.relative[k] & REL_N)) {
+                n += c.relative[k] & REL_N ? n_shift : 0;
+                in_range = in_range and n >= 0 and n < num_norm;
+            }
+            in_range = in_range and v >= 0 and v < num_pos;
+            corner_v[corner_base[i] + k] = v;
+            corner_n[corner_base[i] + k] = n;
+        }
+        c = ObjChunk();
+    }
+    if(!in_range) return fail(filename, "face index out of range");
+
+    build_model(pos, norm, corner_v, corner_n, model);
+    return true;
+}
+
+/* PLY */
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+static PlyType ply_type(const std::string &name)
+{
+    if(name == "char" or name == "int8") return PlyType::Int8;
+    if(name == "uchar" or name == "uint8") return PlyType::UInt8;
+    if(name == "short" or name == "int16") return PlyType::Int16;
+    if(name == "ushort" or name == "uint16") return PlyType::UInt16;
+    if(name == "int" or name == "int32") return PlyType::Int32;
+    if(name == "uint" or name == "uint32") return PlyType::UInt32;
+    if(name == "float" or name == "float32") return PlyType::Float32;
+    if(name == "double" or name == "float64") return PlyType::Float64;
+    return PlyType::Invalid;
+}
+
+static int ply_size(PlyType t)
+{
+    switch(t) {
+    case PlyType::Int8: case PlyType::UInt8: return 1;
+    case PlyType::Int16: case PlyType::UInt16: return 2;
+    case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+    case PlyType::Float64: return 8;
+    case PlyType::Invalid: break;
+    }
+    return 0;
+}
+
+// Face indices are read as doubles, anything that is not a valid
+// int64_t comes back as -1 and fails the range check later
+static int64_t ply_index(double v)
+{
+    return v >= 0.0 and v < 9.0e18 ? int64_t(v) : -1;
+}
+
+struct PlyProperty
+{
+    std::string name;
+    PlyType type;
+    PlyType count_type = PlyType::Invalid;  // set for lists
+    int offset = 0;                         // in a fixed size binary record
+};
+
+struct PlyElement
+{
+    std::string name;
+    size_t count;
+    std::vector<PlyProperty> props;
+    int stride = 0;                         // 0 if the element has lists
+
+    int find(const std::string &prop) const
+    {
+        for(size_t i = 0; i < props.size(); i++) {
+            if(props[i].name == prop) return i;
+        }
+        return -1;
+    }
+};
+
+// Reads one binary value of type t, swapping bytes if needed
+static inline double ply_read(const char *p, PlyType t, bool swap)
+{
+    char b[8];
+    int n = ply_size(t);
+    std::memcpy(b, p, n);
+    if(swap) std::reverse(b, b + n);
+    switch(t) {
+    case PlyType::Int8: { int8_t v; std::memcpy(&v, b, 1); return v; }
+    case PlyType::UInt8: { uint8_t v; std::memcpy(&v, b, 1); return v; }
+    case PlyType::Int16: { int16_t v; std::memcpy(&v, b, 2); return v; }
+    case PlyType::UInt16: { uint16_t v; std::memcpy(&v, b, 2); return v; }
+    case PlyType::Int32: { int32_t v; std::memcpy(&v, b, 4); return v; }
+    case PlyType::UInt32: { uint32_t v; std::memcpy(&v, b, 4); return v; }
+    case PlyType::Float32: { float v; std::memcpy(&v, b, 4); return v; }
+    case PlyType::Float64: { double v; std::memcpy(&v, b, 8); return v; }
+    case PlyType::Invalid: break;
+    }
+    return 0;
+}
+
+bool import_ply(const std::string &filename, Model &model)
+{
+    FileMapping file(filename);
+    if(!file.data) return fail(filename, "can't read file");
+
+    const char *p = file.data;
+    const char *end = file.end();
+    if(file.size < 4 or std::strncmp(p, "ply", 3) != 0) return fail(filename, "not a PLY file");
+
+    enum { ASCII, LITTLE, BIG } format = ASCII;
+    std::vector<PlyElement> elements;
+    bool header_done = false;
+    while(p < end and !header_done) {
+        const char *line_end = next_line(p, end);
+        std::string line(p, line_end - p);
+        p = line_end;
+        while(!line.empty() and (line.back() == '\n' or line.back() == '\r')) line.pop_back();
+
+        std::vector<std::string> tok;
+        size_t pos = 0;
+        while(pos < line.size()) {
+            size_t s = line.find_first_not_of(" \t", pos);
+            if(s == std::string::npos) break;
+            size_t e = line.find_first_of(" \t", s);
+            tok.push_back(line.substr(s, e == std::string::npos ? std::string::npos : e - s));
+            pos = e == std::string::npos ? line.size() : e;
+        }
+        if(tok.empty()) continue;
+
+        if(tok[0] == "format" and tok.size() >= 2) {
+            if(tok[1] == "ascii") format = ASCII;
+            else if(tok[1] == "binary_little_endian") format = LITTLE;
+            else if(tok[1] == "binary_big_endian") format = BIG;
+            else return fail(filename, "unknown format " + tok[1]);
+        } else if(tok[0] == "element" and tok.size() >= 3) {
+            size_t count = 0;
+            const char *first = tok[2].data(), *last = first + tok[2].size();
+            auto res = std::from_chars(first, last, count);
+            if(res.ec != std::errc() or res.ptr != last) return fail(filename, "bad element count");
+            elements.push_back(PlyElement({tok[1], count, {}, 0}));
+        } else if(tok[0] == "property" and !elements.empty()) {
+            PlyProperty prop;
+            if(tok.size() >= 5 and tok[1] == "list") {
+                prop.count_type = ply_type(tok[2]);
+                prop.type = ply_type(tok[3]);
+                prop.name = tok[4];
+                if(prop.count_type == PlyType::Invalid) return fail(filename, "bad list type");
+            } else if(tok.size() >= 3) {
+                prop.type = ply_type(tok[1]);
+                prop.name = tok[2];
+            } else {
+                return fail(filename, "bad property");
+            }
+            if(prop.type == PlyType::Invalid) return fail(filename, "bad property type");
+            elements.back().props.push_back(prop);
+        } else if(tok[0] == "end_header") {
+            header_done = true;
+        }
+    }
+    if(!header_done) return fail(filename, "no end_header");
+
+    for(auto &el : elements) {
+        int offset = 0;
+        bool fixed = true;
+        for(auto &prop : el.props) {
+            prop.offset = offset;
+            offset += ply_size(prop.type);
+            fixed = fixed and prop.count_type == PlyType::Invalid;
+        }
+        el.stride = fixed ? offset : 0;
+    }
+
+    std::vector<float> pos, norm;
+    std::vector<int64_t> corner_v, corner_n;
+    bool swap = format == BIG;
+
+    for(const PlyElement &el : elements) {
+        bool is_vertex = el.name == "vertex";
+        bool is_face = el.name == "face";
+        int xyz[3] = { el.find("x"), el.find("y"), el.find("z") };
+        int nxyz[3] = { el.find("nx"), el.find("ny"), el.find("nz") };
+        bool has_normals = nxyz[0] >= 0 and nxyz[1] >= 0 and nxyz[2] >= 0;
+        int list = el.find("vertex_indices");
+        if(list < 0) list = el.find("vertex_index");
+
+        // Every record takes at least one byte in ASCII and the sizes of its
+        // scalars and list counts in binary, so a count the rest of the
+        // file can't hold is rejected before anything is allocated for it
+        size_t min_record = 1;
+        if(format != ASCII) {
+            size_t bytes = 0;
+            for(const PlyProperty &prop : el.props) {
+                bytes += ply_size(prop.count_type != PlyType::Invalid ? prop.count_type : prop.type);
+            }
+            min_record = std::max<size_t>(bytes, 1);
+        }
+        if(el.count > size_t(end - p) / min_record) return fail(filename, "element count exceeds file size");
+
+        if(is_vertex) {
+            if(xyz[0] < 0 or xyz[1] < 0 or xyz[2] < 0) return fail(filename, "vertex without x, y, z");
+            pos.resize(el.count * 3);
+            if(has_normals) norm.resize(el.count * 3);
+        }
+        if(is_face and (list < 0 or el.props[list].count_type == PlyType::Invalid)) {
+            return fail(filename, "face without vertex_indices");
+        }
+
+        if(format == ASCII) {
+            std::vector<double> values;
+            for(size_t i = 0; i < el.count; i++) {
+                if(p >= end) return fail(filename, "truncated data");
+                const char *line_end = next_line(p, end);
+                values.clear();
+                std::vector<double> face;
+                for(size_t k = 0; k < el.props.size(); k++) {
+                    size_t n = 1;
+                    if(el.props[k].count_type != PlyType::Invalid) {
+                        double cnt;
+                        p = skip_blanks(p, line_end);
+                        auto res = std::from_chars(p, line_end, cnt);
+                        if(res.ec != std::errc()) return fail(filename, "bad number");
+                        p = res.ptr;
+                        // Each list entry needs at least a blank and a digit
+                        if(!(cnt >= 0.0 and cnt <= double(line_end - p))) {
+                            return fail(filename, "bad list count");
+                        }
+                        n = size_t(cnt);
+                    }
+                    for(size_t j = 0; j < n; j++) {
+                        double v;
+                        p = skip_blanks(p, line_end);
+                        auto res = std::from_chars(p, line_end, v);
+                        if(res.ec != std::errc()) return fail(filename, "bad number");
+                        p = res.ptr;
+                        if(int(k) == list and is_face) face.push_back(v);
+                        else if(el.props[k].count_type == PlyType::Invalid) values.push_back(v);
+                    }
+                    if(el.props[k].count_type != PlyType::Invalid) values.push_back(0);
+                }
+                p = line_end;
+
+                if(is_vertex) {
+                    for(int c = 0; c < 3; c++) pos[i * 3 + c] = values[xyz[c]];
+                    if(has_normals) {
+                        for(int c = 0; c < 3; c++) norm[i * 3 + c] = values[nxyz[c]];
+                    }
+                } else if(is_face) {
+                    for(size_t j = 2; j < face.size(); j++) {
+                        corner_v.push_back(ply_index(face[0]));
+                        corner_v.push_back(ply_index(face[j - 1]));
+                        corner_v.push_back(ply_index(face[j]));
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Binary
+        if(el.stride > 0) {
+            if(is_vertex) {
+                const char *base = p;
+                #pragma omp parallel for
+                for(size_t i = 0; i < el.count; i++) {
+                    const char *rec = base + i * el.stride;
+                    for(int c = 0; c < 3; c++) {
+                        const PlyProperty &prop = el.props[xyz[c]];
+                        pos[i * 3 + c] = ply_read(rec + prop.offset, prop.type, swap);
+                    }
+                    if(has_normals) {
+                        for(int c = 0; c < 3; c++) {
+                            const PlyProperty &prop = el.props[nxyz[c]];
+                            norm[i * 3 + c] = ply_read(rec + prop.offset, prop.type, swap);
+                        }
+                    }
+                }
+            }
+            p += el.count * el.stride;
+            continue;
+        }
+
+        // Records with lists have to be walked in order
+        if(is_vertex) return fail(filename, "lists in vertex records");
+        if(is_face) corner_v.reserve(el.count * 3);
+        int64_t face[64];
+        for(size_t i = 0; i < el.count; i++) {
+            for(size_t k = 0; k < el.props.size(); k++) {
+                const PlyProperty &prop = el.props[k];
+                size_t n = 1;
+                if(prop.count_type != PlyType::Invalid) {
+                    if(p + ply_size(prop.count_type) > end) return fail(filename, "truncated data");
+                    n = size_t(ply_read(p, prop.count_type, swap));
+                    p += ply_size(prop.count_type);
+                }
+                size_t sz = ply_size(prop.type);
+                if(n > size_t(end - p) / sz) return fail(filename, "truncated data");
+                if(is_face and int(k) == list) {
+                    if(n > 64) return fail(filename, "face with more than 64 corners");
+                    for(size_t j = 0; j < n; j++) face[j] = ply_index(ply_read(p + j * sz, prop.type, swap));
+                    for(size_t j = 2; j < n; j++) {
+                        corner_v.push_back(face[0]);
+                        corner_v.push_back(face[j - 1]);
+                        corner_v.push_back(face[j]);
+                    }
+                }
+                p += n * sz;
+            }
+        }
+    }
+
+    int64_t num_pos = pos.size() / 3;
+    bool in_range = true;
+    #pragma omp parallel for reduction(&&:in_range)
+    for(size_t i = 0; i < corner_v.size(); i++) {
+        in_range = in_range and corner_v[i] >= 0 and corner_v[i] < num_pos;
+    }
+    if(!in_range) return fail(filename, "face index out of range");
+
+    // PLY normals are per vertex
+    if(!norm.empty()) corner_n = corner_v;
+    build_model(pos, norm, corner_v, corner_n, model);
+    return true;
+}
+
+/* Native format */
+
+static uint64_t align_up(uint64_t v)
+{
+    return (v + MESH_ALIGN - 1) / MESH_ALIGN * MESH_ALIGN;
+}
+
+bool write_mesh(const Model &model, const std::string &filename)
+{
+    const VertexBuffer &vb = model.vertices;
+    const IndexBuffer &ib = model.indices;
+    const VertexLayout &layout = vb.getLayout();
+    if(layout.numAttribs() > MESH_MAX_ATTRIBS) {
+        std::cout << "Too many attributes for a mesh file" << std::endl;
+        return false;
+    }
+
+    MeshFileHeader header = { };
+    std::memcpy(header.magic, MESH_MAGIC, 4);
+    header.version = MESH_VERSION;
+    header.num_attribs = layout.numAttribs();
+    for(int i = 0; i < layout.numAttribs(); i++) {
+        header.attribs[i] = uint8_t(layout.type(i));
+    }
+    header.index_type = uint32_t(ib.getType());
+    header.num_vertices = vb.size();
+    header.num_indices = ib.size();
+
+    size_t vertex_bytes = vb.size() * layout.getStride() * sizeof(float);
+    size_t index_bytes = ib.size() * (ib.getType() == IndexType::U16 ? 2 : 4);
+    header.vertex_offset = align_up(sizeof(header));
+    header.index_offset = align_up(header.vertex_offset + vertex_bytes);
+
+    // Written next to the target and renamed over it, so a Mesh that still
+    // maps the old file keeps its inode and a crash never leaves a torn file
+    std::string tmp_name = filename + ".tmp";
+    FILE *f = fopen(tmp_name.c_str(), "wb");
+    if(!f) {
+        std::cout << "Can't save mesh: " << filename << std::endl;
+        return false;
+    }
+
+    static const char zeros[MESH_ALIGN] = { };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok and fwrite(zeros, 1, header.vertex_offset - sizeof(header), f) ==
+        header.vertex_offset - sizeof(header);
+    ok = ok and fwrite(vb.getRawData(), 1, vertex_bytes, f) == vertex_bytes;
+    size_t pad = header.index_offset - header.vertex_offset - vertex_bytes;
+    ok = ok and fwrite(zeros, 1, pad, f) == pad;
+    ok = ok and fwrite(ib.getRawData(), 1, index_bytes, f) == index_bytes;
+    ok = ok and fflush(f) == 0;
+    ok = fclose(f) == 0 and ok;
+    ok = ok and rename(tmp_name.c_str(), filename.c_str()) == 0;
+    if(!ok) {
+        std::cout << "Can't save mesh: " << filename << std::endl;
+        remove(tmp_name.c_str());
+    }
+    return ok;
+}
+
+// Whether `count` elements of `size` bytes from `offset` end inside the
+// file, without overflowing
+static bool fits_in_file(uint64_t offset, uint64_t count, uint64_t size, uint64_t file_size)
+{
+    if(offset > file_size or size == 0) return false;
+    return count <= (file_size - offset) / size;
+}
+
+template<typename T>
+static uint64_t max_mapped_index(const T *indices, uint64_t count)
+{
+    T res = 0;
+    #pragma omp parallel for reduction(max:res)
+    for(int64_t i = 0; i < int64_t(count); i++) {
+        res = std::max(res, indices[i]);
+    }
+    return res;
+}
+
+Mesh::~Mesh()
+{
+    if(mapping) munmap(mapping, mapping_size);
+}
+
+bool Mesh::map(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0 or fstat(fd, &st) != 0 or size_t(st.st_size) < sizeof(MeshFileHeader)) {
+        if(fd >= 0) close(fd);
+        return false;
+    }
+    void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(ptr == MAP_FAILED) return false;
+
+    const char *data = static_cast<const char*>(ptr);
+    auto *h = reinterpret_cast<const MeshFileHeader*>(data);
+    uint64_t file_size = st.st_size;
+
+    bool valid = std::memcmp(h->magic, MESH_MAGIC, 4) == 0 and h->version == MESH_VERSION
+        and h->num_attribs > 0 and h->num_attribs <= MESH_MAX_ATTRIBS
+        and (h->index_type == uint32_t(IndexType::U16) or
+             h->index_type == uint32_t(IndexType::U32));
+    VertexLayout layout;
+    for(uint32_t i = 0; valid and i < h->num_attribs; i++) {
+        valid = h->attribs[i] <= uint8_t(AttribType::Vec4);
+        if(valid) layout.add(AttribType(h->attribs[i]));
+    }
+    size_t index_size = h->index_type == uint32_t(IndexType::U16) ? 2 : 4;
+    valid = valid
+        and h->vertex_offset % sizeof(float) == 0 and h->index_offset % index_size == 0
+        and fits_in_file(h->vertex_offset, h->num_vertices, layout.getStride() * sizeof(float),
+                         file_size)
+        and fits_in_file(h->index_offset, h->num_indices, index_size, file_size);
+    if(!valid) {
+        std::cout << "Not a mesh file or unsupported version: " << filename << std::endl;
+        munmap(ptr, st.st_size);
+        return false;
+    }
+
+    // A stale or corrupt file must not send draws outside of the vertices
+    uint64_t max_index = 0;
+    if(index_size == 2) {
+        max_index = max_mapped_index(
+                reinterpret_cast<const uint16_t*>(data + h->index_offset), h->num_indices);
+    } else {
+        max_index = max_mapped_index(
+                reinterpret_cast<const uint32_t*>(data + h->index_offset), h->num_indices);
+    }
+    if(h->num_indices > 0 and max_index >= h->num_vertices) {
+        std::cout << "Mesh file has indices out of range: " << filename << std::endl;
+        munmap(ptr, st.st_size);
+        return false;
+    }
+
+    if(mapping) munmap(mapping, mapping_size);
+    mapping = ptr;
+    mapping_size = st.st_size;
+
+    model.vertices = VertexBuffer::view(layout,
+            reinterpret_cast<const float*>(data + h->vertex_offset), h->num_vertices);
+    if(index_size == 2) {
+        model.indices = IndexBuffer::view(
+                reinterpret_cast<const uint16_t*>(data + h->index_offset), h->num_indices);
+    } else {
+        model.indices = IndexBuffer::view(
+                reinterpret_cast<const uint32_t*>(data + h->index_offset), h->num_indices);
+    }
+    return true;
+}
+
+static bool ends_with(const std::string &s, const std::string &suffix)
+{
+    return s.size() >= suffix.size() and
+        std::equal(suffix.rbegin(), suffix.rend(), s.rbegin(),
+                   [](char a, char b) { return std::tolower(a) == b; });
+}
+
+static bool newer_than(const std::string &a, const std::string &b)
+{
+    struct stat sa, sb;
+    if(stat(a.c_str(), &sa) != 0 or stat(b.c_str(), &sb) != 0) return false;
+    return sa.st_mtim.tv_sec > sb.st_mtim.tv_sec or
+        (sa.st_mtim.tv_sec == sb.st_mtim.tv_sec and sa.st_mtim.tv_nsec >= sb.st_mtim.tv_nsec);
+}
+
+bool load_mesh(const std::string &filename, Mesh &mesh, bool cache)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::string cache_name = filename + ".tgm";
+    const char *how = "mapped";
+    bool ok;
+
+    if(ends_with(filename, ".tgm")) {
+        ok = mesh.map(filename);
+    } else if(cache and newer_than(cache_name, filename) and mesh.map(cache_name)) {
+        ok = true;
+        how = "mapped cache";
+    } else {
+        Model model;
+        if(ends_with(filename, ".obj")) {
+            ok = import_obj(filename, model);
+        } else if(ends_with(filename, ".ply")) {
+            ok = import_ply(filename, model);
+        } else {
+            std::cout << "Unknown mesh format: " << filename << std::endl;
+            ok = false;
+        }
+        how = "imported";
+        // Baked into the cache, so every later load gets the better order
+        if(ok) {
+            MeshOptReport report = optimize_mesh(model);
+            std::cout << "Mesh optimised: ACMR " << report.acmr_before << " -> "
+                      << report.acmr_after << ", overdraw " << report.overdraw_before
+                      << " -> " << report.overdraw_after << "\n";
+        }
+        if(ok and cache and write_mesh(model, cache_name) and mesh.map(cache_name)) {
+            // The mapped copy replaces the imported buffers
+        } else if(ok) {
+            mesh = Mesh(std::move(model));
+        }
+    }
+
+    if(!ok) return false;
+
+    auto end = std::chrono::steady_clock::now();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const Model &m = mesh.getModel();
+    std::cout << "Loaded " << filename << " (" << how << "): "
+              << m.vertices.size() << " vertices, " << m.indices.numTriangles() << " triangles in "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms, peak RSS "
+              << usage.ru_maxrss / 1024 << " MB\n";
+    return true;
+}
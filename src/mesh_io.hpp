@@ -0,0 +1,105 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  mesh_io.hpp
+ *
+ *    Description:  OBJ/PLY import and a native binary mesh format
+ *
+ *        Version:  1.0
+ *        Created:  22.10.2026 13:48:02
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef MESH_IO_HPP
+#define MESH_IO_HPP
+
+#include <string>
+#include <cstdint>
+
+#include "model.hpp"
+
+/*
+ * Native mesh file (little endian):
+ *   MeshFileHeader
+ *   vertex data       interleaved floats as in VertexBuffer, 64 byte aligned
+ *   index data        uint16 or uint32, 64 byte aligned
+ *
+ * The data is laid out exactly like the in-memory buffers, a mapped file
+ * is used by the model without any copy or parsing.
+ */
+
+const uint32_t MESH_VERSION = 1;
+const int MESH_MAX_ATTRIBS = 8;
+
+struct MeshFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t num_attribs;
+    uint8_t attribs[MESH_MAX_ATTRIBS];  // AttribType
+    uint32_t index_type;                // IndexType
+    uint64_t num_vertices;
+    uint64_t num_indices;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+};
+
+// Triangulated import, faces with more than three corners become fans.
+// Positions go to attribute 0, normals (when the file has any) to 1.
+bool import_obj(const std::string &filename, Model &model);
+bool import_ply(const std::string &filename, Model &model);
+
+// Replaces `filename` atomically, existing mappings of it stay valid
+bool write_mesh(const Model &model, const std::string &filename);
+
+// A model together with the memory behind it: either its own buffers or
+// a read-only mapping of a native mesh file that the buffers view.
+class Mesh
+{
+    Model model;
+    void *mapping = nullptr;
+    size_t mapping_size = 0;
+
+public:
+    Mesh() { }
+    Mesh(Model &&model) : model(std::move(model)) { }
+    ~Mesh();
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    Mesh(Mesh &&other) :
+        model(std::move(other.model)), mapping(other.mapping), mapping_size(other.mapping_size)
+    {
+        other.mapping = nullptr;
+    }
+
+    Mesh& operator=(Mesh &&other)
+    {
+        std::swap(model, other.model);
+        std::swap(mapping, other.mapping);
+        std::swap(mapping_size, other.mapping_size);
+        return *this;
+    }
+
+    // Maps a native mesh file, false if it is missing or invalid
+    bool map(const std::string &filename);
+
+    bool isMapped() const { return mapping != nullptr; }
+    const Model& getModel() const { return model; }
+};
+
+// Loads .obj, .ply or native files. Imported files are run through
+// optimize_mesh. With `cache` an imported file is converted to a native
+// one next to it (<file>.tgm) and mapped, later loads map that directly
+// while it is newer than the source.
+// Prints load time and peak memory.
+bool load_mesh(const std::string &filename, Mesh &mesh, bool cache = true);
+
+#endif
@@ -0,0 +1,361 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  mesh_opt.cpp
+ *
+ *    Description:  Triangle and vertex reordering for cache reuse and overdraw
+ *
+ *        Version:  1.0
+ *        Created:  22.10.2026 17:12:40
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "mesh_opt.hpp"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+float compute_acmr(const IndexBuffer &indices, int cache_size)
+{
+    if(indices.numTriangles() == 0) return 0.0f;
+
+    // FIFO with timestamps: a vertex is cached if it entered less than
+    // cache_size misses ago
+    std::vector<size_t> entered;
+    size_t misses = 0;
+    for(size_t i = 0; i < indices.numTriangles() * 3; i++) {
+        uint32_t v = indices[i];
+        if(v >= entered.size()) entered.resize(v + 1, 0);
+        if(entered[v] == 0 or misses - (entered[v] - 1) >= size_t(cache_size)) {
+            entered[v] = misses + 1;
+            misses++;
+        }
+    }
+    return float(misses) / indices.numTriangles();
+}
+
+float compute_overdraw(const Model &model, int resolution)
+{
+    const VertexBuffer &vb = model.vertices;
+    const IndexBuffer &ib = model.indices;
+    if(vb.size() == 0 or ib.numTriangles() == 0) return 0.0f;
+
+    float lo[3], hi[3];
+    for(int c = 0; c < 3; c++) {
+        lo[c] = std::numeric_limits<float>::max();
+        hi[c] = -std::numeric_limits<float>::max();
+    }
+    for(size_t i = 0; i < vb.size(); i++) {
+        for(int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], vb.vertex(i)[c]);
+            hi[c] = std::max(hi[c], vb.vertex(i)[c]);
+        }
+    }
+    float extent = 0.0f;
+    for(int c = 0; c < 3; c++) extent = std::max(extent, hi[c] - lo[c]);
+    if(extent <= 0.0f) return 0.0f;
+    float scale = (resolution - 1) / extent;
+
+    size_t shaded = 0, covered = 0;
+
+    // Axis `axis` is depth, viewed from the low (dir 0) or high (dir 1) side
+    #pragma omp parallel for reduction(+:shaded,covered)
+    for(int view = 0; view < 6; view++) {
+        int axis = view / 2;
+        float sign = view % 2 ? -1.0f : 1.0f;
+        int ax = (axis + 1) % 3;
+        int ay = (axis + 2) % 3;
+
+        std::vector<float> depth(size_t(resolution) * resolution,
+                                 std::numeric_limits<float>::max());
+        size_t view_shaded = 0;
+
+        for(size_t t = 0; t < ib.numTriangles(); t++) {
+            float px[3], py[3], pz[3];
+            for(int k = 0; k < 3; k++) {
+                const float *p = vb.vertex(ib[t * 3 + k]);
+                px[k] = (p[ax] - lo[ax]) * scale;
+                py[k] = (p[ay] - lo[ay]) * scale;
+                pz[k] = sign * (p[axis] - (sign > 0 ? lo[axis] : hi[axis]));
+            }
+
+            float area = (px[1] - px[0]) * (py[2] - py[0]) - (py[1] - py[0]) * (px[2] - px[0]);
+            if(area == 0.0f) continue;
+
+            int x0 = std::max(0, int(std::floor(std::min({px[0], px[1], px[2]}))));
+            int x1 = std::min(resolution - 1, int(std::ceil(std::max({px[0], px[1], px[2]}))));
+            int y0 = std::max(0, int(std::floor(std::min({py[0], py[1], py[2]}))));
+            int y1 = std::min(resolution - 1, int(std::ceil(std::max({py[0], py[1], py[2]}))));
+
+            for(int y = y0; y <= y1; y++) {
+                for(int x = x0; x <= x1; x++) {
+                    float sx = x + 0.5f, sy = y + 0.5f;
+                    float w0 = (px[2] - px[1]) * (sy - py[1]) - (py[2] - py[1]) * (sx - px[1]);
+                    float w1 = (px[0] - px[2]) * (sy - py[2]) - (py[0] - py[2]) * (sx - px[2]);
+                    float w2 = area - w0 - w1;
+                    // Either winding, the pipeline does not cull
+                    bool inside = area > 0 ? (w0 >= 0 and w1 >= 0 and w2 >= 0)
+                                           : (w0 <= 0 and w1 <= 0 and w2 <= 0);
+                    if(!inside) continue;
+
+                    float z = (w0 * pz[0] + w1 * pz[1] + w2 * pz[2]) / area;
+                    float &d = depth[size_t(y) * resolution + x];
+                    if(z < d) {
+                        d = z;
+                        view_shaded++;
+                    }
+                }
+            }
+        }
+
+        shaded += view_shaded;
+        for(float d : depth) covered += d != std::numeric_limits<float>::max();
+    }
+
+    return covered ? float(shaded) / covered : 0.0f;
+}
+
+void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t num_vertices,
+                           int cache_size, std::vector<uint32_t> *clusters)
+{
+    size_t num_tris = indices.size() / 3;
+    if(num_tris == 0) return;
+
+    // Triangles of every vertex, CSR
+    std::vector<uint32_t> live(num_vertices, 0);
+    for(uint32_t v : indices) live[v]++;
+    std::vector<uint32_t> start(num_vertices + 1, 0);
+    for(size_t v = 0; v < num_vertices; v++) start[v + 1] = start[v] + live[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+        for(size_t i = 0; i < indices.size(); i++) {
+            adjacency[fill[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<int64_t> cached_at(num_vertices, -(cache_size + 1));
+    std::vector<uint8_t> emitted(num_tris, 0);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    if(clusters) clusters->clear();
+
+    int64_t stamp = 0;
+    size_t cursor = 0;
+    int64_t fan = indices[0];
+    bool new_cluster = true;
+
+    while(fan >= 0) {
+        candidates.clear();
+        for(uint32_t a = start[fan]; a < start[fan + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if(emitted[t]) continue;
+            if(new_cluster and clusters) clusters->push_back(out.size() / 3);
+            new_cluster = false;
+            for(int k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                out.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if(stamp - cached_at[v] > cache_size) {
+                    cached_at[v] = stamp++;
+                }
+            }
+            emitted[t] = 1;
+        }
+
+        // Next fan: the candidate that stays in cache the longest and
+        // will not be evicted before its remaining triangles are emitted
+        int64_t best = -1, best_priority = -1;
+        for(uint32_t v : candidates) {
+            if(live[v] == 0) continue;
+            int64_t priority = 0;
+            if(stamp - cached_at[v] + 2 * int64_t(live[v]) <= cache_size) {
+                priority = stamp - cached_at[v];
+            }
+            if(priority > best_priority) {
+                best_priority = priority;
+                best = v;
+            }
+        }
+
+        if(best < 0) {
+            // Dead end: a recently used vertex, else the next one in order
+            new_cluster = true;
+            while(!dead_end.empty() and best < 0) {
+                uint32_t d = dead_end.back();
+                dead_end.pop_back();
+                if(live[d] > 0) best = d;
+            }
+            while(best < 0 and cursor < num_vertices) {
+                if(live[cursor] > 0) best = cursor;
+                cursor++;
+            }
+        }
+        fan = best;
+    }
+
+    indices.swap(out);
+}
+
+// FIFO cache simulation over triangles [t0, t1), restarted at every
+// boundary it adds. Returns the misses of the range.
+static size_t split_cluster(const std::vector<uint32_t> &indices, size_t t0, size_t t1,
+                            float max_acmr, int cache_size, std::vector<size_t> &cached_at,
+                            size_t &clock, std::vector<uint32_t> *boundaries)
+{
+    size_t misses = 0, start = t0, start_misses = 0, start_clock = clock;
+    for(size_t t = t0; t < t1; t++) {
+        for(int k = 0; k < 3; k++) {
+            uint32_t v = indices[t * 3 + k];
+            if(cached_at[v] <= start_clock or clock - cached_at[v] >= size_t(cache_size)) {
+                cached_at[v] = ++clock;
+                misses++;
+            }
+        }
+        if(boundaries and t + 1 < t1 and
+                float(misses - start_misses) <= max_acmr * (t + 1 - start)) {
+            boundaries->push_back(t + 1);
+            start = t + 1;
+            start_misses = misses;
+            start_clock = clock;
+        }
+    }
+    return misses;
+}
+
+void optimize_overdraw(std::vector<uint32_t> &indices, const VertexBuffer &vertices,
+                       const std::vector<uint32_t> &hard_clusters, float threshold,
+                       int cache_size)
+{
+    size_t num_tris = indices.size() / 3;
+    if(num_tris == 0) return;
+
+    std::vector<uint32_t> clusters;
+    std::vector<size_t> cached_at(vertices.size(), 0);
+    size_t clock = 0;
+    for(size_t c = 0; c < hard_clusters.size(); c++) {
+        size_t t0 = hard_clusters[c];
+        size_t t1 = c + 1 < hard_clusters.size() ? hard_clusters[c + 1] : num_tris;
+        size_t misses = split_cluster(indices, t0, t1, 0.0f, cache_size, cached_at, clock,
+                                      nullptr);
+        float acmr = float(misses) / (t1 - t0);
+        clusters.push_back(t0);
+        split_cluster(indices, t0, t1, threshold * acmr, cache_size, cached_at, clock,
+                      &clusters);
+    }
+
+    size_t num_clusters = clusters.size();
+    if(num_clusters < 2) return;
+
+    // Area weighted centroid and normal of every cluster
+    std::vector<Vec3> centroid(num_clusters, Vec3({0,0,0}));
+    std::vector<Vec3> normal(num_clusters, Vec3({0,0,0}));
+    std::vector<float> area(num_clusters, 0.0f);
+    Vec3 mesh_centroid({0,0,0});
+    float mesh_area = 0.0f;
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t c = 0; c < num_clusters; c++) {
+        size_t t1 = c + 1 < num_clusters ? clusters[c + 1] : num_tris;
+        Vec3 sum({0,0,0}), n({0,0,0});
+        float a = 0.0f;
+        for(size_t t = clusters[c]; t < t1; t++) {
+            const float *p[3];
+            for(int k = 0; k < 3; k++) p[k] = vertices.vertex(indices[t * 3 + k]);
+            Vec3 p0({p[0][0], p[0][1], p[0][2]});
+            Vec3 p1({p[1][0], p[1][1], p[1][2]});
+            Vec3 p2({p[2][0], p[2][1], p[2][2]});
+            Vec3 cross = tmath::cross(p1 - p0, p2 - p0);
+            float ta = tmath::length(cross) * 0.5f;
+            sum = sum + ta * (p0 + p1 + p2) / 3.0f;
+            n = n + cross;
+            a += ta;
+        }
+        centroid[c] = sum;
+        normal[c] = n;
+        area[c] = a;
+    }
+
+    for(size_t c = 0; c < num_clusters; c++) {
+        mesh_centroid = mesh_centroid + centroid[c];
+        mesh_area += area[c];
+    }
+    if(mesh_area > 0.0f) mesh_centroid = mesh_centroid / mesh_area;
+
+    std::vector<float> key(num_clusters, 0.0f);
+    for(size_t c = 0; c < num_clusters; c++) {
+        if(area[c] <= 0.0f) continue;
+        Vec3 d = centroid[c] / area[c] - mesh_centroid;
+        float len = tmath::length(normal[c]);
+        if(len > 0.0f) key[c] = tmath::dot(d, normal[c] / len);
+    }
+
+    std::vector<uint32_t> order(num_clusters);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&key](uint32_t a, uint32_t b) { return key[a] > key[b]; });
+
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    for(uint32_t c : order) {
+        size_t t1 = c + 1 < num_clusters ? clusters[c + 1] : num_tris;
+        out.insert(out.end(), indices.begin() + clusters[c] * 3, indices.begin() + t1 * 3);
+    }
+    indices.swap(out);
+}
+
+void optimize_vertex_fetch(std::vector<uint32_t> &indices, const VertexBuffer &vertices,
+                           std::vector<float> &out)
+{
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    int stride = vertices.getLayout().getStride();
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    uint32_t next = 0;
+    for(uint32_t &v : indices) {
+        if(remap[v] == unused) remap[v] = next++;
+        v = remap[v];
+    }
+
+    out.resize(size_t(next) * stride);
+    #pragma omp parallel for
+    for(size_t v = 0; v < vertices.size(); v++) {
+        if(remap[v] == unused) continue;
+        std::copy_n(vertices.vertex(v), stride, out.begin() + size_t(remap[v]) * stride);
+    }
+}
+
+MeshOptReport optimize_mesh(Model &model, bool overdraw)
+{
+    MeshOptReport report = { };
+    report.acmr_before = compute_acmr(model.indices);
+    if(overdraw) report.overdraw_before = compute_overdraw(model);
+
+    std::vector<uint32_t> indices(model.indices.numTriangles() * 3);
+    for(size_t i = 0; i < indices.size(); i++) indices[i] = model.indices[i];
+
+    std::vector<uint32_t> clusters;
+    optimize_vertex_cache(indices, model.vertices.size(), VERTEX_CACHE_SIZE,
+                          overdraw ? &clusters : nullptr);
+    if(overdraw) optimize_overdraw(indices, model.vertices, clusters);
+
+    std::vector<float> values;
+    optimize_vertex_fetch(indices, model.vertices, values);
+    model.vertices = VertexBuffer(model.vertices.getLayout(), std::move(values));
+    model.indices = IndexBuffer(indices);
+
+    report.acmr_after = compute_acmr(model.indices);
+    if(overdraw) report.overdraw_after = compute_overdraw(model);
+    return report;
+}
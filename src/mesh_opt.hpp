@@ -0,0 +1,69 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  mesh_opt.hpp
+ *
+ *    Description:  Triangle and vertex reordering for cache reuse and overdraw
+ *
+ *        Version:  1.0
+ *        Created:  22.10.2026 17:12:40
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef MESH_OPT_HPP
+#define MESH_OPT_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include "model.hpp"
+
+const int VERTEX_CACHE_SIZE = 16;
+
+// Average vertex shader runs per triangle with a FIFO post-transform
+// cache of `cache_size` entries. 3 is the worst case, ~0.5-0.7 is
+// typical for a well ordered grid.
+float compute_acmr(const IndexBuffer &indices, int cache_size = VERTEX_CACHE_SIZE);
+
+// Fragments that pass a less-than depth test per covered pixel, averaged
+// over orthographic views along the six axis directions. 1 means every
+// pixel is shaded once. Attribute 0 must be the Vec3 position.
+float compute_overdraw(const Model &model, int resolution = 256);
+
+// Tipsify (Sander, Nehab, Barczak 2007). Linear in the number of
+// triangles. If `clusters` is given it receives the first triangle of
+// every run that started at a dead end, runs are free to be reordered.
+void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t num_vertices,
+                           int cache_size = VERTEX_CACHE_SIZE,
+                           std::vector<uint32_t> *clusters = nullptr);
+
+// Orders clusters so that those facing away from the mesh centre come
+// first, they tend to occlude the rest. The runs from
+// optimize_vertex_cache are split further wherever the ACMR so far is
+// within `threshold` of the run's own, which bounds the cache cost of
+// the reordering (Sander et al.'s lambda).
+void optimize_overdraw(std::vector<uint32_t> &indices, const VertexBuffer &vertices,
+                       const std::vector<uint32_t> &clusters, float threshold = 1.05f,
+                       int cache_size = VERTEX_CACHE_SIZE);
+
+// Renumbers vertices in order of first use and drops unused ones
+void optimize_vertex_fetch(std::vector<uint32_t> &indices, const VertexBuffer &vertices,
+                           std::vector<float> &out);
+
+struct MeshOptReport
+{
+    float acmr_before, acmr_after;
+    float overdraw_before, overdraw_after;
+};
+
+// All of the above in order, the model gets owned buffers. Returns the
+// before and after figures, printing them is up to the caller.
+MeshOptReport optimize_mesh(Model &model, bool overdraw = true);
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  meshlet.cpp
+ *
+ *    Description:  Splitting of models into small clusters that are culled as a whole
+ *
+ *        Version:  1.0
+ *        Created:  23.10.2026 09:26:14
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "meshlet.hpp"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+static Vec3 position(const VertexBuffer &vb, uint32_t v)
+{
+    const float *p = vb.vertex(v);
+    return Vec3({p[0], p[1], p[2]});
+}
+
+static Meshlet meshlet_bounds(const VertexBuffer &vb, const std::vector<uint32_t> &indices,
+                              uint32_t first, uint32_t count)
+{
+    Meshlet m;
+    m.first_triangle = first;
+    m.num_triangles = count;
+
+    // Sphere around the box centre, not minimal but cheap and close for
+    // the compact patches build_meshlets makes
+    float lo[3], hi[3];
+    for(int c = 0; c < 3; c++) {
+        lo[c] = std::numeric_limits<float>::max();
+        hi[c] = -std::numeric_limits<float>::max();
+    }
+    for(size_t i = first * 3; i < (first + count) * 3; i++) {
+        const float *p = vb.vertex(indices[i]);
+        for(int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], p[c]);
+            hi[c] = std::max(hi[c], p[c]);
+        }
+    }
+    m.center = Vec3({(lo[0] + hi[0]) * 0.5f, (lo[1] + hi[1]) * 0.5f, (lo[2] + hi[2]) * 0.5f});
+    float r2 = 0.0f;
+    for(size_t i = first * 3; i < (first + count) * 3; i++) {
+        r2 = std::max(r2, tmath::length2(position(vb, indices[i]) - m.center));
+    }
+    m.radius = std::sqrt(r2);
+
+    // Cone: average of the unit normals, opened to the widest one.
+    // Degenerate triangles face nowhere and are left out.
+    std::vector<Vec3> normals;
+    normals.reserve(count);
+    Vec3 axis({0,0,0});
+    for(uint32_t t = first; t < first + count; t++) {
+        Vec3 p0 = position(vb, indices[t * 3]);
+        Vec3 p1 = position(vb, indices[t * 3 + 1]);
+        Vec3 p2 = position(vb, indices[t * 3 + 2]);
+        Vec3 n = tmath::cross(p1 - p0, p2 - p0);
+        float len = tmath::length(n);
+        if(len <= 0.0f) continue;
+        normals.push_back(n / len);
+        axis = axis + normals.back();
+    }
+
+    m.cone_axis = Vec3({0,0,1});
+    m.cone_cutoff = 2.0f;
+    float len = tmath::length(axis);
+    if(normals.empty() or len <= 0.0f) return m;
+    axis = axis / len;
+
+    float min_dot = 1.0f;
+    for(const Vec3 &n : normals) min_dot = std::min(min_dot, tmath::dot(n, axis));
+
+    // Past ~85 degrees the cone hardly ever culls, keep the test cheap
+    m.cone_axis = axis;
+    if(min_dot > 0.1f) m.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    return m;
+}
+
+void build_meshlets(Model &model, int max_triangles)
+{
+    const VertexBuffer &vb = model.vertices;
+    const IndexBuffer &ib = model.indices;
+    size_t num_tris = ib.numTriangles();
+    size_t num_vertices = vb.size();
+    model.meshlets.clear();
+    if(num_tris == 0 or max_triangles <= 0) return;
+
+    std::vector<uint32_t> indices(num_tris * 3);
+    for(size_t i = 0; i < indices.size(); i++) indices[i] = ib[i];
+
+    // Triangles of every vertex, CSR
+    std::vector<uint32_t> start(num_vertices + 1, 0);
+    for(uint32_t v : indices) start[v + 1]++;
+    for(size_t v = 0; v < num_vertices; v++) start[v + 1] += start[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+        for(size_t i = 0; i < indices.size(); i++) {
+            adjacency[fill[indices[i]]++] = i / 3;
+        }
+    }
+
+    // Breadth first growth over shared vertices keeps meshlets round,
+    // which keeps the spheres tight. Seeds follow the current order so
+    // the cache order from optimize_mesh mostly survives.
+    std::vector<uint8_t> taken(num_tris, 0);
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    std::vector<uint32_t> queue;
+    size_t seed = 0;
+
+    while(true) {
+        while(seed < num_tris and taken[seed]) seed++;
+        if(seed == num_tris) break;
+
+        uint32_t first = out.size() / 3;
+        queue.clear();
+        queue.push_back(seed);
+        taken[seed] = 1;
+        size_t head = 0;
+        while(head < queue.size() and queue.size() < size_t(max_triangles)) {
+            uint32_t t = queue[head++];
+            for(int k = 0; k < 3 and queue.size() < size_t(max_triangles); k++) {
+                uint32_t v = indices[t * 3 + k];
+                for(uint32_t a = start[v]; a < start[v + 1]; a++) {
+                    uint32_t n = adjacency[a];
+                    if(taken[n]) continue;
+                    taken[n] = 1;
+                    queue.push_back(n);
+                    if(queue.size() == size_t(max_triangles)) break;
+                }
+            }
+        }
+
+        // Emitted in seed order to disturb the vertex cache order less
+        std::sort(queue.begin(), queue.end());
+        for(uint32_t t : queue) {
+            for(int k = 0; k < 3; k++) out.push_back(indices[t * 3 + k]);
+        }
+        model.meshlets.push_back({first, uint32_t(queue.size()), Vec3(), 0.0f, Vec3(), 0.0f});
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i = 0; i < model.meshlets.size(); i++) {
+        Meshlet &m = model.meshlets[i];
+        m = meshlet_bounds(vb, out, m.first_triangle, m.num_triangles);
+    }
+
+    model.indices = IndexBuffer(out, ib.getType() == IndexType::U16);
+}
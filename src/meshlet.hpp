@@ -0,0 +1,63 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  meshlet.hpp
+ *
+ *    Description:  Splitting of models into small clusters that are culled as a whole
+ *
+ *        Version:  1.0
+ *        Created:  23.10.2026 09:26:14
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef MESHLET_HPP
+#define MESHLET_HPP
+
+#include "model.hpp"
+#include "bounds.hpp"
+
+const int MESHLET_MAX_TRIANGLES = 128;
+
+// Grows meshlets of up to `max_triangles` connected triangles, starting
+// from the current triangle order, and reorders the index buffer so each
+// is contiguous. Attribute 0 must be the Vec3 position.
+void build_meshlets(Model &model, int max_triangles = MESHLET_MAX_TRIANGLES);
+
+// Culls meshlets against the view frustum and by their normal cone.
+// Works in model space, so it needs the full model to clip transform and
+// the camera position in model coordinates.
+class ClusterCuller
+{
+    Frustum frustum;
+    Vec3 camera;
+
+public:
+    ClusterCuller(const Mat4 &model_to_clip, const Vec3 &model_camera) :
+        frustum(model_to_clip), camera(model_camera)
+    { }
+
+    bool outsideFrustum(const Meshlet &m) const
+    {
+        return frustum.outside(m.center, m.radius);
+    }
+
+    // Every triangle faces away from the camera
+    bool backFacing(const Meshlet &m) const
+    {
+        Vec3 d = m.center - camera;
+        return tmath::dot(d, m.cone_axis) >= m.cone_cutoff * tmath::length(d) + m.radius;
+    }
+
+    bool cull(const Meshlet &m) const
+    {
+        return outsideFrustum(m) or backFacing(m);
+    }
+};
+
+#endif
@@ -16,18 +16,293 @@
  * =====================================================================================
  */
 
+#ifndef MODEL_HPP
+#define MODEL_HPP
+
+#include <vector>
+#include <cstdint>
+#include <initializer_list>
+
 #include "rasterizer.hpp"
 #include "shader.hpp"
 
 using VertexVec = std::vector<Vertex>;
 
-using TriIndeces = std::tuple<unsigned, unsigned, unsigned>;
+// Attribute types a vertex buffer can hold, one per Attribute alternative
+enum class AttribType : uint8_t {
+    Float,
+    Vec3,
+    Vec4
+};
 
-struct Model
+inline int attrib_size(AttribType type)
+{
+    switch(type) {
+    case AttribType::Float: return 1;
+    case AttribType::Vec3: return 3;
+    case AttribType::Vec4: return 4;
+    }
+    return 0;
+}
+
+// Types and float offsets of the attributes of one interleaved vertex
+class VertexLayout
+{
+    std::vector<AttribType> types;
+    std::vector<int> offsets;
+    int stride = 0;
+public:
+    VertexLayout() { }
+    VertexLayout(std::initializer_list<AttribType> attribs)
+    {
+        for(AttribType t : attribs) add(t);
+    }
+
+    void add(AttribType type)
+    {
+        types.push_back(type);
+        offsets.push_back(stride);
+        stride += attrib_size(type);
+    }
+
+    int numAttribs() const { return types.size(); }
+    int getStride() const { return stride; }
+    AttribType type(int i) const { return types[i]; }
+    int offset(int i) const { return offsets[i]; }
+
+    bool operator==(const VertexLayout &other) const { return types == other.types; }
+    bool operator!=(const VertexLayout &other) const { return types != other.types; }
+
+    // Unpacks one vertex, `out` is resized to numAttribs()
+    void decode(const float *v, AttribVec &out) const
+    {
+        out.resize(types.size());
+        for(size_t i = 0; i < types.size(); i++) {
+            const float *p = v + offsets[i];
+            switch(types[i]) {
+            case AttribType::Float:
+                out[i] = p[0];
+                break;
+            case AttribType::Vec3:
+                out[i] = Vec3({p[0], p[1], p[2]});
+                break;
+            case AttribType::Vec4:
+                out[i] = Vec4({p[0], p[1], p[2], p[3]});
+                break;
+            }
+        }
+    }
+
+    // Packs attributes of the matching types into `stride` floats
+    void encode(const AttribVec &attrs, float *v) const
+    {
+        for(size_t i = 0; i < types.size(); i++) {
+            float *p = v + offsets[i];
+            std::visit(overload {
+                    [p](float f) { p[0] = f; },
+                    [p](const Vec3 &a) { for(int c = 0; c < 3; c++) p[c] = a[c]; },
+                    [p](const Vec4 &a) { for(int c = 0; c < 4; c++) p[c] = a[c]; }
+                    }, attrs[i]);
+        }
+    }
+};
+
+// Interleaved vertices, getStride() floats each. Either owns its storage
+// or views memory owned by someone else (a mapped file, another buffer)
+// without copying, in which case that memory must outlive it.
+class VertexBuffer
 {
-    std::vector<AttribVec> v_attrs;
-    std::vector<TriIndeces> indeces; 
+    VertexLayout layout;
+    std::vector<float> owned;
+    const float *values = nullptr;
+    size_t count = 0;
+
+public:
+    VertexBuffer() { }
+    VertexBuffer(const VertexLayout &layout) : layout(layout) { }
+
+    VertexBuffer(const VertexLayout &layout, std::vector<float> &&data) :
+        layout(layout), owned(std::move(data)),
+        values(owned.data()),
+        count(layout.getStride() ? owned.size() / layout.getStride() : 0)
+    { }
+
+    static VertexBuffer view(const VertexLayout &layout, const float *data, size_t count)
+    {
+        VertexBuffer vb(layout);
+        vb.values = data;
+        vb.count = count;
+        return vb;
+    }
+
+    VertexBuffer(const VertexBuffer &other) :
+        layout(other.layout), owned(other.owned),
+        values(other.ownsData() ? owned.data() : other.values),
+        count(other.count)
+    { }
+
+    VertexBuffer& operator=(const VertexBuffer &other)
+    {
+        layout = other.layout;
+        owned = other.owned;
+        values = other.ownsData() ? owned.data() : other.values;
+        count = other.count;
+        return *this;
+    }
+
+    // Moving a vector keeps its storage, so values stays valid
+    VertexBuffer(VertexBuffer &&other) = default;
+    VertexBuffer& operator=(VertexBuffer &&other) = default;
+
+    bool ownsData() const { return values == owned.data() and !owned.empty(); }
+
+    // Appends a vertex, copies viewed data into owned storage first
+    void push(const AttribVec &attrs)
+    {
+        if(!ownsData()) {
+            owned.assign(values, values + count * layout.getStride());
+        }
+        owned.resize(owned.size() + layout.getStride());
+        layout.encode(attrs, owned.data() + count * layout.getStride());
+        values = owned.data();
+        count++;
+    }
+
+    const VertexLayout& getLayout() const { return layout; }
+    size_t size() const { return count; }
+    const float* getRawData() const { return values; }
+    const float* vertex(size_t i) const { return values + i * layout.getStride(); }
+
+    void decode(size_t i, AttribVec &out) const { layout.decode(vertex(i), out); }
 };
 
+enum class IndexType : uint8_t {
+    U16,
+    U32
+};
 
+// Triangle list indices, 16 or 32 bit. Owning or a view like VertexBuffer.
+class IndexBuffer
+{
+    IndexType type = IndexType::U32;
+    std::vector<uint16_t> owned16;
+    std::vector<uint32_t> owned32;
+    const void *values = nullptr;
+    size_t count = 0;
+
+    void repoint()
+    {
+        if(!owned16.empty()) values = owned16.data();
+        if(!owned32.empty()) values = owned32.data();
+    }
+
+public:
+    IndexBuffer() { }
+
+    // Stored as 16 bit when every index fits and `compact` is set
+    IndexBuffer(const std::vector<uint32_t> &indices, bool compact = true) :
+        count(indices.size())
+    {
+        bool fits = std::all_of(indices.begin(), indices.end(),
+                                [](uint32_t i) { return i <= 0xffff; });
+        if(compact and fits) {
+            type = IndexType::U16;
+            owned16.assign(indices.begin(), indices.end());
+        } else {
+            owned32 = indices;
+        }
+        repoint();
+    }
+
+    IndexBuffer(std::initializer_list<uint32_t> indices) :
+        IndexBuffer(std::vector<uint32_t>(indices))
+    { }
+
+    static IndexBuffer view(const uint16_t *data, size_t count)
+    {
+        IndexBuffer ib;
+        ib.type = IndexType::U16;
+        ib.values = data;
+        ib.count = count;
+        return ib;
+    }
+
+    static IndexBuffer view(const uint32_t *data, size_t count)
+    {
+        IndexBuffer ib;
+        ib.type = IndexType::U32;
+        ib.values = data;
+        ib.count = count;
+        return ib;
+    }
+
+    IndexBuffer(const IndexBuffer &other) :
+        type(other.type), owned16(other.owned16), owned32(other.owned32),
+        values(other.values), count(other.count)
+    {
+        repoint();
+    }
+
+    IndexBuffer& operator=(const IndexBuffer &other)
+    {
+        type = other.type;
+        owned16 = other.owned16;
+        owned32 = other.owned32;
+        values = other.values;
+        count = other.count;
+        repoint();
+        return *this;
+    }
+
+    IndexBuffer(IndexBuffer &&other) = default;
+    IndexBuffer& operator=(IndexBuffer &&other) = default;
+
+    IndexType getType() const { return type; }
+    size_t size() const { return count; }
+    size_t numTriangles() const { return count / 3; }
+    const void* getRawData() const { return values; }
+
+    uint32_t operator[](size_t i) const
+    {
+        if(type == IndexType::U16) return static_cast<const uint16_t*>(values)[i];
+        return static_cast<const uint32_t*>(values)[i];
+    }
+};
+
+// A run of triangles that is culled as a whole, see meshlet.hpp
+struct Meshlet
+{
+    uint32_t first_triangle;
+    uint32_t num_triangles;
+    Vec3 center;            // bounding sphere, model space
+    float radius;
+    Vec3 cone_axis;         // normal cone: sine of the half angle
+    float cone_cutoff;      // around the axis, > 1 never culls
+};
+
+// Coarser versions of a model's triangles over the same vertices, see lod.hpp
+struct LODLevel
+{
+    IndexBuffer indices;
+    float error;            // accumulated quadric RMS error, model units, not a bound
+};
+
+struct LODChain
+{
+    std::vector<LODLevel> levels;   // finest first, the model itself excluded
+    Vec3 center;                    // bounding sphere, model space
+    float radius = 0.0f;
+};
+
+struct Model
+{
+    VertexBuffer vertices;
+    IndexBuffer indices;
+    // Empty unless build_meshlets was run, the triangles of each meshlet
+    // are contiguous in `indices`
+    std::vector<Meshlet> meshlets;
+    // Empty unless build_lods was run
+    LODChain lods;
+};
 
+#endif
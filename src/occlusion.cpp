@@ -0,0 +1,117 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  occlusion.cpp
+ *
+ *    Description:  Low resolution depth buffer for occlusion culling
+ *
+ *        Version:  1.0
+ *        Created:  23.10.2026 14:40:27
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "occlusion.hpp"
+
+#include <cmath>
+#include <limits>
+
+// Clip w below which a point counts as behind the eye
+static const float MIN_W = 1e-5f;
+
+static int clamp_cell(float v, int size)
+{
+    return int(std::clamp(v, 0.0f, float(size - 1)));
+}
+
+void OcclusionBuffer::rasterize(const Model &model, const Mat4 &model_to_clip)
+{
+    const VertexBuffer &vb = model.vertices;
+    const IndexBuffer &ib = model.indices;
+
+    // Screen positions of all vertices, z is NDC depth, w < 0 marks a
+    // vertex behind the near plane
+    std::vector<Vec4> screen(vb.size());
+    #pragma omp parallel for
+    for(size_t i = 0; i < vb.size(); i++) {
+        const float *p = vb.vertex(i);
+        Vec4 c = model_to_clip * Vec4({p[0], p[1], p[2], 1.0f});
+        if(c[3] < MIN_W) {
+            screen[i] = Vec4({0, 0, 0, -1});
+            continue;
+        }
+        screen[i] = Vec4({(c[0] / c[3] + 1.0f) * 0.5f * width,
+                          (1.0f - c[1] / c[3]) * 0.5f * height,
+                          c[2] / c[3], 1.0f});
+    }
+
+    for(size_t t = 0; t < ib.numTriangles(); t++) {
+        const Vec4 &a = screen[ib[3*t]];
+        const Vec4 &b = screen[ib[3*t+1]];
+        const Vec4 &c = screen[ib[3*t+2]];
+        if(a[3] < 0.0f or b[3] < 0.0f or c[3] < 0.0f) continue;
+
+        float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+        if(area == 0.0f) continue;
+        float z = std::max({a[2], b[2], c[2]});
+        if(z > 1.0f or std::min({a[2], b[2], c[2]}) < -1.0f) continue;
+
+        int x0 = clamp_cell(std::min({a[0], b[0], c[0]}), width);
+        int x1 = clamp_cell(std::max({a[0], b[0], c[0]}), width);
+        int y0 = clamp_cell(std::min({a[1], b[1], c[1]}), height);
+        int y1 = clamp_cell(std::max({a[1], b[1], c[1]}), height);
+
+        // Edge functions at cell centres, either winding
+        float s = area > 0.0f ? 1.0f : -1.0f;
+        for(int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            for(int x = x0; x <= x1; x++) {
+                float px = x + 0.5f;
+                float e0 = ((b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0])) * s;
+                float e1 = ((c[0] - b[0]) * (py - b[1]) - (c[1] - b[1]) * (px - b[0])) * s;
+                float e2 = ((a[0] - c[0]) * (py - c[1]) - (a[1] - c[1]) * (px - c[0])) * s;
+                if(e0 < 0.0f or e1 < 0.0f or e2 < 0.0f) continue;
+                float &d = depth[y * width + x];
+                d = std::min(d, z);
+            }
+        }
+    }
+}
+
+bool OcclusionBuffer::visible(const AABB &box, const Mat4 &to_clip) const
+{
+    if(box.empty()) return false;
+
+    float min_x = std::numeric_limits<float>::max(), max_x = -min_x;
+    float min_y = min_x, max_y = -min_x;
+    float min_z = min_x;
+    for(int i = 0; i < 8; i++) {
+        Vec4 c = to_clip * tmath::toVec4(box.corner(i), 1.0f);
+        if(c[3] < MIN_W) return true;
+        float x = (c[0] / c[3] + 1.0f) * 0.5f * width;
+        float y = (1.0f - c[1] / c[3]) * 0.5f * height;
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        min_z = std::min(min_z, c[2] / c[3]);
+    }
+
+    if(max_x < 0.0f or min_x > width or max_y < 0.0f or min_y > height) return false;
+    int x0 = clamp_cell(min_x - 1.0f, width);
+    int x1 = clamp_cell(max_x + 1.0f, width);
+    int y0 = clamp_cell(min_y - 1.0f, height);
+    int y1 = clamp_cell(max_y + 1.0f, height);
+
+    for(int y = y0; y <= y1; y++) {
+        for(int x = x0; x <= x1; x++) {
+            if(depth[y * width + x] >= min_z) return true;
+        }
+    }
+    return false;
+}
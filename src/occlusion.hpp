@@ -0,0 +1,58 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  occlusion.hpp
+ *
+ *    Description:  Low resolution depth buffer for occlusion culling
+ *
+ *        Version:  1.0
+ *        Created:  23.10.2026 14:40:27
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+#include <vector>
+
+#include "model.hpp"
+#include "bounds.hpp"
+
+// Depth only rendering of a few large occluders at a fraction of the
+// screen resolution, in NDC depth (smaller is closer). A cell holds the
+// farthest depth of the triangle covering its centre, so what it stores
+// is never in front of the real surface.
+class OcclusionBuffer
+{
+    int width;
+    int height;
+    std::vector<float> depth;
+
+public:
+    OcclusionBuffer(int width = 256, int height = 144) :
+        width(width), height(height), depth(width * height, 1.0f)
+    { }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    float getDepth(int x, int y) const { return depth[y * width + x]; }
+
+    void clear() { std::fill(depth.begin(), depth.end(), 1.0f); }
+
+    // Triangles crossing the near plane are skipped, they would only add
+    // occlusion. Attribute 0 must be the Vec3 position.
+    void rasterize(const Model &model, const Mat4 &model_to_clip);
+
+    // False only if every cell the projected box touches (grown by one
+    // cell for partially covered edges) has an occluder in front of the
+    // nearest point of the box
+    bool visible(const AABB &box, const Mat4 &to_clip) const;
+};
+
+#endif
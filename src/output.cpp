@@ -0,0 +1,271 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  output.cpp
+ *
+ *    Description:  Uncompressed image and video outputs
+ *
+ *        Version:  1.0
+ *        Created:  20.10.2026 15:20:44
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "output.hpp"
+
+#include <cctype>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Rows converted per batch by the streaming writers
+static const int BATCH_ROWS = 64;
+
+static bool ends_with(const std::string &s, const std::string &suffix)
+{
+    return s.size() >= suffix.size() and
+        std::equal(suffix.rbegin(), suffix.rend(), s.rbegin(),
+                   [](char a, char b) { return std::tolower(a) == b; });
+}
+
+ImageFileFormat image_format_from_name(const std::string &filename)
+{
+    if(ends_with(filename, ".ppm")) return ImageFileFormat::PPM;
+    if(ends_with(filename, ".pfm")) return ImageFileFormat::PFM;
+    return ImageFileFormat::PNG;
+}
+
+static FILE* open_output(const std::string &filename)
+{
+    FILE *f = fopen(filename.c_str(), "wb");
+    if(!f) {
+        std::cerr << "Can't save image: " << filename << std::endl;
+    }
+    return f;
+}
+
+bool write_ppm(const ColorBuffer &image, const std::string &filename, Dither dither)
+{
+    FILE *f = open_output(filename);
+    if(!f) return false;
+
+    int w = image.getWidth();
+    int h = image.getHeight();
+    fprintf(f, "P6\n%d %d\n255\n", w, h);
+
+    std::vector<uchar> batch(size_t(BATCH_ROWS) * w * 3);
+    bool ok = true;
+    for(int y = 0; y < h and ok; y += BATCH_ROWS) {
+        int y1 = std::min(y + BATCH_ROWS, h);
+        image.encodeRows(y, y1, batch.data(), 3 * w, 3, dither);
+        size_t len = size_t(y1 - y) * w * 3;
+        ok = fwrite(batch.data(), 1, len, f) == len;
+    }
+
+    fclose(f);
+    return ok;
+}
+
+bool write_pfm(const ColorBuffer &image, const std::string &filename)
+{
+    FILE *f = open_output(filename);
+    if(!f) return false;
+
+    int w = image.getWidth();
+    int h = image.getHeight();
+    // Negative scale means little endian
+    fprintf(f, "PF\n%d %d\n-1.0\n", w, h);
+
+    std::vector<float> rgba(size_t(w) * 4);
+    std::vector<float> rgb(size_t(w) * 3);
+    bool ok = true;
+    for(int y = h - 1; y >= 0 and ok; y--) {
+        image.loadRow(y, rgba.data());
+        for(int x = 0; x < w; x++) {
+            for(int c = 0; c < 3; c++) {
+                rgb[x * 3 + c] = rgba[x * 4 + c];
+            }
+        }
+        ok = fwrite(rgb.data(), sizeof(float), rgb.size(), f) == rgb.size();
+    }
+
+    fclose(f);
+    return ok;
+}
+
+/* Y4M */
+
+Y4MWriter::Y4MWriter(const std::string &filename, int fps, Y4MChroma chroma) :
+    fps(fps), chroma(chroma)
+{
+    if(filename == "-") {
+        out = stdout;
+    } else {
+        out = fopen(filename.c_str(), "wb");
+        owns_file = true;
+        if(!out) {
+            std::cerr << "Can't open video output: " << filename << std::endl;
+        }
+    }
+}
+
+Y4MWriter::~Y4MWriter()
+{
+    if(out and owns_file) {
+        fclose(out);
+    } else if(out) {
+        fflush(out);
+    }
+}
+
+static inline uchar rgb2y(int r, int g, int b)
+{
+    return uchar(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline uchar rgb2u(int r, int g, int b)
+{
+    return uchar(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline uchar rgb2v(int r, int g, int b)
+{
+    return uchar(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+bool Y4MWriter::write(const ColorBuffer &image)
+{
+    if(!out) return false;
+
+    if(width == 0) {
+        width = image.getWidth();
+        height = image.getHeight();
+        fprintf(out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 %s\n", width, height, fps,
+                chroma == Y4MChroma::C420 ? "C420jpeg" : "C444");
+    } else if(image.getWidth() != width or image.getHeight() != height) {
+        std::cerr << "Y4M frame size changed mid-stream" << std::endl;
+        return false;
+    }
+
+    int cw = chroma == Y4MChroma::C420 ? (width + 1) / 2 : width;
+    int ch = chroma == Y4MChroma::C420 ? (height + 1) / 2 : height;
+    size_t luma_size = size_t(width) * height;
+    size_t chroma_size = size_t(cw) * ch;
+
+    rgb.resize(luma_size * 3);
+    planes.resize(luma_size + 2 * chroma_size);
+    image.toSRGB(rgb.data(), 3 * width, 3);
+
+    uchar *py = planes.data();
+    uchar *pu = py + luma_size;
+    uchar *pv = pu + chroma_size;
+    const uchar *src = rgb.data();
+    int w = width;
+    int h = height;
+
+    #pragma omp parallel for
+    for(int y = 0; y < h; y++) {
+        const uchar *row = src + size_t(y) * w * 3;
+        for(int x = 0; x < w; x++) {
+            py[size_t(y) * w + x] = rgb2y(row[3*x], row[3*x+1], row[3*x+2]);
+        }
+    }
+
+    #pragma omp parallel for
+    for(int y = 0; y < ch; y++) {
+        for(int x = 0; x < cw; x++) {
+            int r = 0, g = 0, b = 0, n = 0;
+            int step = chroma == Y4MChroma::C420 ? 2 : 1;
+            for(int dy = 0; dy < step; dy++) {
+                for(int dx = 0; dx < step; dx++) {
+                    int sy = std::min(y * step + dy, h - 1);
+                    int sx = std::min(x * step + dx, w - 1);
+                    const uchar *p = src + (size_t(sy) * w + sx) * 3;
+                    r += p[0]; g += p[1]; b += p[2]; n++;
+                }
+            }
+            r /= n; g /= n; b /= n;
+            pu[size_t(y) * cw + x] = rgb2u(r, g, b);
+            pv[size_t(y) * cw + x] = rgb2v(r, g, b);
+        }
+    }
+
+    fputs("FRAME\n", out);
+    return fwrite(planes.data(), 1, planes.size(), out) == planes.size();
+}
+
+/* Memory mapped PPM */
+
+MappedImageFile::MappedImageFile(const std::string &filename, int width, int height) :
+    width(width), height(height)
+{
+    char header[64];
+    header_size = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    file_size = header_size + size_t(width) * height * 3;
+
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 or ftruncate(fd, file_size) != 0) {
+        std::cerr << "Can't create mapped image: " << filename << std::endl;
+        if(fd >= 0) close(fd);
+        return;
+    }
+
+    void *ptr = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(ptr == MAP_FAILED) {
+        std::cerr << "Can't map image: " << filename << std::endl;
+        return;
+    }
+
+    data = static_cast<uchar*>(ptr);
+    std::memcpy(data, header, header_size);
+}
+
+MappedImageFile::~MappedImageFile()
+{
+    if(data) {
+        munmap(data, file_size);
+    }
+}
+
+void MappedImageFile::resolve(const ColorBuffer &image, Dither dither)
+{
+    if(!data) return;
+    int h = std::min(height, image.getHeight());
+    if(image.getWidth() != width) {
+        std::cerr << "Mapped image size mismatch" << std::endl;
+        return;
+    }
+    image.encodeRows(0, h, getPixels(), getPitch(), 3, dither);
+}
+
+void MappedImageFile::resolve(const ColorBuffer &image, const std::vector<TileRect> &rects,
+                              Dither dither)
+{
+    if(!data) return;
+    if(image.getWidth() != width) {
+        std::cerr << "Mapped image size mismatch" << std::endl;
+        return;
+    }
+    for(const TileRect &r : rects) {
+        int y1 = std::min(r.y1, std::min(height, image.getHeight()));
+        if(r.y0 >= y1) continue;
+        image.encodeRect(r.y0, r.x0, y1, r.x1,
+                         getPixels() + size_t(r.y0) * getPitch() + size_t(r.x0) * 3,
+                         getPitch(), 3, dither);
+    }
+}
+
+void MappedImageFile::sync()
+{
+    if(data) {
+        msync(data, file_size, MS_ASYNC);
+    }
+}
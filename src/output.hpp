@@ -0,0 +1,107 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  output.hpp
+ *
+ *    Description:  Uncompressed image and video outputs (PPM, PFM, Y4M, mapped files)
+ *
+ *        Version:  1.0
+ *        Created:  20.10.2026 15:20:44
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+#include "tiles.hpp"
+
+enum class ImageFileFormat {
+    PNG,
+    // Binary P6, 8 bit sRGB
+    PPM,
+    // Linear float RGB, rows bottom to top as the format wants
+    PFM
+};
+
+// Picks the format from the file extension, PNG when unknown
+ImageFileFormat image_format_from_name(const std::string &filename);
+
+bool write_ppm(const ColorBuffer &image, const std::string &filename,
+               Dither dither = Dither::None);
+
+bool write_pfm(const ColorBuffer &image, const std::string &filename);
+
+enum class Y4MChroma {
+    C444,
+    // 2x2 averaged chroma, what most encoders expect
+    C420
+};
+
+// Streams frames as YUV4MPEG2 (BT.601, limited range) into a file, a named
+// pipe or stdout when the name is "-". The header goes out with the first
+// frame, whose size fixes the size of the stream. Errors are reported on
+// stderr, so they never end up inside a stream on stdout.
+class Y4MWriter
+{
+    FILE *out = nullptr;
+    bool owns_file = false;
+    int fps;
+    Y4MChroma chroma;
+    int width = 0;
+    int height = 0;
+
+    std::vector<uchar> rgb;
+    std::vector<uchar> planes;
+
+public:
+    Y4MWriter(const std::string &filename, int fps = 30, Y4MChroma chroma = Y4MChroma::C420);
+    ~Y4MWriter();
+
+    Y4MWriter(const Y4MWriter&) = delete;
+    Y4MWriter& operator=(const Y4MWriter&) = delete;
+
+    bool isOpen() const { return out != nullptr; }
+    bool write(const ColorBuffer &image);
+};
+
+// A binary PPM mapped into memory. Colour buffers are resolved straight
+// into the mapping, the file is a valid image at all times and other
+// processes can read it in place.
+class MappedImageFile
+{
+    int width, height;
+    size_t header_size = 0;
+    size_t file_size = 0;
+    uchar *data = nullptr;
+
+public:
+    MappedImageFile(const std::string &filename, int width, int height);
+    ~MappedImageFile();
+
+    MappedImageFile(const MappedImageFile&) = delete;
+    MappedImageFile& operator=(const MappedImageFile&) = delete;
+
+    bool isOpen() const { return data != nullptr; }
+    uchar* getPixels() { return data + header_size; }
+    int getPitch() const { return 3 * width; }
+
+    void resolve(const ColorBuffer &image, Dither dither = Dither::None);
+    // Re-encodes only `rects`, e.g. from Framebuffer::takeDirtyRects()
+    void resolve(const ColorBuffer &image, const std::vector<TileRect> &rects,
+                 Dither dither = Dither::None);
+    // Schedules write back of the mapping to disk
+    void sync();
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  pixel_format.cpp
+ *
+ *    Description:  Row kernels for converting between pixel formats
+ *
+ *        Version:  1.0
+ *        Created:  19.10.2026 14:02:17
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "pixel_format.hpp"
+
+// Bayer thresholds, already centred: (b + 0.5) / 64 - 0.5 of a code
+static const float bayer8[8][8] = {
+#define T(b) ((b + 0.5f) / 64.0f - 0.5f)
+    { T( 0), T(32), T( 8), T(40), T( 2), T(34), T(10), T(42) },
+    { T(48), T(16), T(56), T(24), T(50), T(18), T(58), T(26) },
+    { T(12), T(44), T( 4), T(36), T(14), T(46), T( 6), T(38) },
+    { T(60), T(28), T(52), T(20), T(62), T(30), T(54), T(22) },
+    { T( 3), T(35), T(11), T(43), T( 1), T(33), T( 9), T(41) },
+    { T(51), T(19), T(59), T(27), T(49), T(17), T(57), T(25) },
+    { T(15), T(47), T( 7), T(39), T(13), T(45), T( 5), T(37) },
+    { T(63), T(31), T(55), T(23), T(61), T(29), T(53), T(21) }
+#undef T
+};
+
+void encode_srgb_row(const float *src, uchar *dst, int count, int channels,
+                     Dither dither, int y, int x0)
+{
+    const SRGBEncodeTable &table = srgb_encode_table();
+    const float *lut = table.values;
+    const int size = SRGBEncodeTable::SIZE;
+
+    // One threshold per pixel of the row, zero without dithering
+    float thresholds[8] = { 0 };
+    if(dither == Dither::Ordered) {
+        for(int i = 0; i < 8; i++) {
+            thresholds[i] = bayer8[y & 7][(x0 + i) & 7];
+        }
+    }
+
+    #pragma omp simd
+    for(int x = 0; x < count; x++) {
+        const float *p = src + 4 * x;
+        uchar *q = dst + channels * x;
+        float d = thresholds[x & 7];
+        for(int c = 0; c < 3; c++) {
+            float t = saturate(p[c]) * size;
+            int i = std::min(int(t), size - 1);
+            float v = lut[i] + (t - i) * (lut[i+1] - lut[i]);
+            q[c] = uchar(std::clamp(v + d + 0.5f, 0.0f, 255.0f));
+        }
+        if(channels == 4) {
+            q[A] = uchar(saturate(p[A]) * 255.0f + 0.5f);
+        }
+    }
+}
+
+void decode_srgb_row(const uchar *src, float *dst, int count, int channels)
+{
+    const float *lut = srgb_decode_table().values;
+    for(int x = 0; x < count; x++) {
+        const uchar *p = src + channels * x;
+        float *q = dst + 4 * x;
+        q[R] = lut[p[R]];
+        q[G] = lut[p[G]];
+        q[B] = lut[p[B]];
+        q[A] = channels == 4 ? p[A] / 255.0f : 1.0f;
+    }
+}
+
+void half_to_float_row(const uint16_t *src, float *dst, int count)
+{
+    int i = 0;
+#if defined(__F16C__)
+    for(; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+#endif
+    for(; i < count; i++) {
+        dst[i] = half_to_float(src[i]);
+    }
+}
+
+void float_to_half_row(const float *src, uint16_t *dst, int count)
+{
+    int i = 0;
+#if defined(__F16C__)
+    for(; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+#endif
+    for(; i < count; i++) {
+        dst[i] = float_to_half(src[i]);
+    }
+}
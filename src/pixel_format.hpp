@@ -0,0 +1,272 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  pixel_format.hpp
+ *
+ *    Description:  Storage formats for colour buffers and conversions between them
+ *
+ *        Version:  1.0
+ *        Created:  19.10.2026 12:10:31
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef PIXEL_FORMAT_HPP
+#define PIXEL_FORMAT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#include "color.hpp"
+
+// How a colour buffer keeps its pixels.
+// RGBA8_SRGB stores gamma encoded bytes (alpha stays linear), 4 B/pixel.
+// RGBA16F stores IEEE half floats, 8 B/pixel.
+// RGBA32F stores RGBAColor as is, 16 B/pixel.
+enum class PixelFormat {
+    RGBA8_SRGB,
+    RGBA16F,
+    RGBA32F
+};
+
+inline int pixel_size(PixelFormat format)
+{
+    switch(format) {
+    case PixelFormat::RGBA8_SRGB: return 4;
+    case PixelFormat::RGBA16F: return 8;
+    case PixelFormat::RGBA32F: return 16;
+    }
+    return 0;
+}
+
+/* Half floats */
+
+// Round to nearest even, overflow goes to inf, nan stays nan.
+inline uint16_t float_to_half(float value)
+{
+    const uint32_t f32_inf = 255u << 23;
+    const uint32_t f16_max = (127u + 16u) << 23;
+    const uint32_t denorm_magic_bits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint16_t res;
+    if(bits >= f16_max) {
+        res = bits > f32_inf ? 0x7e00 : 0x7c00;
+    } else if(bits < (113u << 23)) {
+        // Subnormal or zero: let the fpu do the rounding
+        float f, magic;
+        std::memcpy(&f, &bits, 4);
+        std::memcpy(&magic, &denorm_magic_bits, 4);
+        f += magic;
+        std::memcpy(&bits, &f, 4);
+        res = bits - denorm_magic_bits;
+    } else {
+        uint32_t mant_odd = (bits >> 13) & 1;
+        bits += ((15u - 127u) << 23) + 0xfff;
+        bits += mant_odd;
+        res = bits >> 13;
+    }
+
+    return res | (sign >> 16);
+}
+
+inline float half_to_float(uint16_t value)
+{
+    const uint32_t shifted_exp = 0x7c00u << 13;
+    const uint32_t magic_bits = 113u << 23;
+
+    uint32_t bits = (value & 0x7fffu) << 13;
+    uint32_t exp = shifted_exp & bits;
+    bits += (127u - 15u) << 23;
+
+    if(exp == shifted_exp) {
+        bits += (128u - 16u) << 23;
+    } else if(exp == 0) {
+        bits += 1u << 23;
+        float f, magic;
+        std::memcpy(&f, &bits, 4);
+        std::memcpy(&magic, &magic_bits, 4);
+        f -= magic;
+        std::memcpy(&bits, &f, 4);
+    }
+
+    bits |= uint32_t(value & 0x8000u) << 16;
+    float res;
+    std::memcpy(&res, &bits, 4);
+    return res;
+}
+
+// Clamps to 0..1 with NaN mapped to 0. std::clamp passes NaN through,
+// which is undefined once it is converted to an integer.
+inline float saturate(float value)
+{
+    return !(value > 0.0f) ? 0.0f : std::min(value, 1.0f);
+}
+
+/* sRGB transfer curve */
+
+inline float linear_to_srgb(float value)
+{
+    value = saturate(value);
+    if(value <= 0.0031308f) {
+        return 12.92f * value;
+    }
+    return 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+inline float srgb_to_linear(float value)
+{
+    if(value <= 0.04045f) {
+        return value / 12.92f;
+    }
+    return std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+// Decoding a byte needs only 256 entries, so it is always a table lookup.
+struct SRGBDecodeTable
+{
+    float values[256];
+
+    SRGBDecodeTable()
+    {
+        for(int i = 0; i < 256; i++) {
+            values[i] = srgb_to_linear(i / 255.0f);
+        }
+    }
+};
+
+// Encoding samples the curve (scaled to 0..255) at 4096 points and
+// interpolates linearly between them, which stays within 0.01 of a code.
+struct SRGBEncodeTable
+{
+    static const int SIZE = 4096;
+    float values[SIZE + 1];
+
+    SRGBEncodeTable()
+    {
+        for(int i = 0; i <= SIZE; i++) {
+            values[i] = 255.0f * linear_to_srgb(float(i) / SIZE);
+        }
+    }
+
+    float operator() (float value) const
+    {
+        float t = saturate(value) * SIZE;
+        int i = std::min(int(t), SIZE - 1);
+        float f = t - i;
+        return values[i] + f * (values[i+1] - values[i]);
+    }
+};
+
+inline const SRGBDecodeTable& srgb_decode_table()
+{
+    static const SRGBDecodeTable table;
+    return table;
+}
+
+inline const SRGBEncodeTable& srgb_encode_table()
+{
+    static const SRGBEncodeTable table;
+    return table;
+}
+
+inline uchar encode_srgb8(float value)
+{
+    return uchar(srgb_encode_table()(value) + 0.5f);
+}
+
+inline uchar encode_unorm8(float value)
+{
+    return uchar(saturate(value) * 255.0f + 0.5f);
+}
+
+inline float decode_srgb8(uchar value)
+{
+    return srgb_decode_table().values[value];
+}
+
+/* Row conversion kernels */
+
+enum class Dither {
+    None,
+    // 8x8 Bayer matrix, tiled over the image
+    Ordered
+};
+
+// Encodes `count` RGBA float pixels into 3 or 4 channel sRGB bytes.
+// `y` and `x0` only pick the dither pattern phase.
+void encode_srgb_row(const float *src, uchar *dst, int count, int channels,
+                     Dither dither = Dither::None, int y = 0, int x0 = 0);
+
+// Decodes `count` 3 or 4 channel sRGB pixels into RGBA floats.
+// Missing alpha is set to 1.
+void decode_srgb_row(const uchar *src, float *dst, int count, int channels);
+
+void half_to_float_row(const uint16_t *src, float *dst, int count);
+void float_to_half_row(const float *src, uint16_t *dst, int count);
+
+/* Packing of a single pixel */
+
+inline void pack_rgba8(const RGBAColor &color, uchar *dst)
+{
+    dst[R] = encode_srgb8(color[R]);
+    dst[G] = encode_srgb8(color[G]);
+    dst[B] = encode_srgb8(color[B]);
+    dst[A] = encode_unorm8(color[A]);
+}
+
+inline RGBAColor unpack_rgba8(const uchar *src)
+{
+    return RGBAColor({
+            decode_srgb8(src[R]),
+            decode_srgb8(src[G]),
+            decode_srgb8(src[B]),
+            src[A] / 255.0f
+            });
+}
+
+inline void pack_rgba16f(const RGBAColor &color, uint16_t *dst)
+{
+#if defined(__F16C__)
+    float tmp[4] = { color[R], color[G], color[B], color[A] };
+    __m128i h = _mm_cvtps_ph(_mm_loadu_ps(tmp), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), h);
+#else
+    for(int c = 0; c < 4; c++) {
+        dst[c] = float_to_half(color[c]);
+    }
+#endif
+}
+
+inline RGBAColor unpack_rgba16f(const uint16_t *src)
+{
+    RGBAColor res;
+#if defined(__F16C__)
+    float tmp[4];
+    __m128i h = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+    _mm_storeu_ps(tmp, _mm_cvtph_ps(h));
+    for(int c = 0; c < 4; c++) res[c] = tmp[c];
+#else
+    for(int c = 0; c < 4; c++) {
+        res[c] = half_to_float(src[c]);
+    }
+#endif
+    return res;
+}
+
+#endif
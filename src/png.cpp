@@ -0,0 +1,199 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  png.cpp
+ *
+ *    Description:  Parallel PNG encoder on top of zlib
+ *
+ *        Version:  1.0
+ *        Created:  20.10.2026 10:14:52
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "png.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include <zlib.h>
+
+static const size_t CHUNK_SIZE = 256 * 1024;
+static const size_t WINDOW_SIZE = 32 * 1024;
+
+static int paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if(pa <= pb and pa <= pc) return a;
+    if(pb <= pc) return b;
+    return c;
+}
+
+// Writes the filter type byte and the filtered row into dst. Tries all five
+// filters and keeps the one with the smallest sum of signed residuals.
+static void filter_row(const uchar *row, const uchar *prev, int bpp, int len,
+                       uchar *dst, uchar *scratch)
+{
+    long best_cost = -1;
+    for(int filter = 0; filter < 5; filter++) {
+        long cost = 0;
+        for(int i = 0; i < len; i++) {
+            int a = i >= bpp ? row[i - bpp] : 0;
+            int b = prev ? prev[i] : 0;
+            int c = (prev and i >= bpp) ? prev[i - bpp] : 0;
+            int pred = 0;
+            switch(filter) {
+            case 1: pred = a; break;
+            case 2: pred = b; break;
+            case 3: pred = (a + b) / 2; break;
+            case 4: pred = paeth(a, b, c); break;
+            }
+            uchar res = row[i] - pred;
+            scratch[i] = res;
+            cost += std::abs(int(static_cast<signed char>(res)));
+        }
+
+        if(best_cost < 0 or cost < best_cost) {
+            best_cost = cost;
+            dst[0] = filter;
+            std::copy(scratch, scratch + len, dst + 1);
+        }
+    }
+}
+
+// Raw deflate of data[begin, end). Every chunk but the last ends with a sync
+// flush, which leaves the stream byte aligned and not final, so the chunk
+// outputs can simply be concatenated.
+static bool deflate_chunk(const uchar *data, size_t begin, size_t end, bool last,
+                          int level, std::vector<uchar> &out)
+{
+    z_stream zs = {};
+    if(deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    if(begin > 0) {
+        size_t dict = std::min(begin, WINDOW_SIZE);
+        deflateSetDictionary(&zs, data + begin - dict, dict);
+    }
+
+    out.resize(deflateBound(&zs, end - begin) + 16);
+    zs.next_in = const_cast<uchar*>(data + begin);
+    zs.avail_in = end - begin;
+    zs.next_out = out.data();
+    zs.avail_out = out.size();
+
+    int res = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+    bool ok = last ? res == Z_STREAM_END : res == Z_OK;
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ok and zs.avail_in == 0;
+}
+
+static void put_u32(std::vector<uchar> &out, uint32_t v)
+{
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+static void put_chunk(std::vector<uchar> &out, const char *type,
+                      const uchar *data, size_t len)
+{
+    put_u32(out, len);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + len);
+    put_u32(out, crc32(0, out.data() + start, len + 4));
+}
+
+std::vector<uchar> encode_png(const uchar *pixels, int width, int height,
+                              int channels, int pitch, int level)
+{
+    int row_len = width * channels;
+    size_t filtered_pitch = size_t(row_len) + 1;
+    std::vector<uchar> filtered(filtered_pitch * height);
+
+    #pragma omp parallel
+    {
+        std::vector<uchar> scratch(row_len);
+        #pragma omp for schedule(static)
+        for(int y = 0; y < height; y++) {
+            const uchar *row = pixels + size_t(y) * pitch;
+            const uchar *prev = y > 0 ? row - pitch : nullptr;
+            filter_row(row, prev, channels, row_len, filtered.data() + y * filtered_pitch,
+                       scratch.data());
+        }
+    }
+
+    size_t total = filtered.size();
+    int num_chunks = std::max<size_t>(1, (total + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    std::vector<std::vector<uchar>> compressed(num_chunks);
+    std::vector<uLong> adlers(num_chunks);
+    bool ok = true;
+
+    #pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+    for(int i = 0; i < num_chunks; i++) {
+        size_t begin = i * CHUNK_SIZE;
+        size_t end = std::min(total, begin + CHUNK_SIZE);
+        ok = deflate_chunk(filtered.data(), begin, end, i == num_chunks - 1,
+                           level, compressed[i]) and ok;
+        adlers[i] = adler32(adler32(0, nullptr, 0), filtered.data() + begin, end - begin);
+    }
+
+    if(!ok) {
+        return { };
+    }
+
+    // zlib stream: header, concatenated raw deflate chunks, adler32
+    std::vector<uchar> zdata = { 0x78, 0x9c };
+    uLong adler = adlers[0];
+    for(int i = 0; i < num_chunks; i++) {
+        zdata.insert(zdata.end(), compressed[i].begin(), compressed[i].end());
+        if(i > 0) {
+            size_t len = std::min(total - i * CHUNK_SIZE, CHUNK_SIZE);
+            adler = adler32_combine(adler, adlers[i], len);
+        }
+    }
+    put_u32(zdata, adler);
+
+    static const uchar signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    std::vector<uchar> png(signature, signature + 8);
+
+    std::vector<uchar> header;
+    put_u32(header, width);
+    put_u32(header, height);
+    header.push_back(8);                        // bit depth
+    header.push_back(channels == 4 ? 6 : 2);    // RGBA or RGB
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+
+    put_chunk(png, "IHDR", header.data(), header.size());
+    put_chunk(png, "IDAT", zdata.data(), zdata.size());
+    put_chunk(png, "IEND", nullptr, 0);
+    return png;
+}
+
+bool write_png(const std::string &filename, const uchar *pixels, int width,
+               int height, int channels, int pitch, int level)
+{
+    std::vector<uchar> png = encode_png(pixels, width, height, channels, pitch, level);
+    FILE *f = png.empty() ? nullptr : fopen(filename.c_str(), "wb");
+    bool ok = f and fwrite(png.data(), 1, png.size(), f) == png.size();
+    if(f) fclose(f);
+    if(!ok) {
+        std::cout << "Can't save image: " << filename << std::endl;
+    }
+    return ok;
+}
@@ -0,0 +1,37 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  png.hpp
+ *
+ *    Description:  Parallel PNG encoder for 8 bit images
+ *
+ *        Version:  1.0
+ *        Created:  20.10.2026 10:14:52
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef PNG_HPP
+#define PNG_HPP
+
+#include <string>
+#include <vector>
+
+#include "color.hpp"
+
+// Encodes 8 bit RGB (3 channels) or RGBA (4 channels) pixels, rows are
+// `pitch` bytes apart. The filter of every row is chosen in parallel and the
+// filtered data is deflated in independent 256 KB chunks (each primed with
+// the preceding 32 KB as dictionary), so the cost spreads over all threads.
+std::vector<uchar> encode_png(const uchar *pixels, int width, int height,
+                              int channels, int pitch, int level = 6);
+
+bool write_png(const std::string &filename, const uchar *pixels, int width,
+               int height, int channels, int pitch, int level = 6);
+
+#endif
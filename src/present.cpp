@@ -0,0 +1,178 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  present.cpp
+ *
+ *    Description:  Buffered presentation of frames with conversion on its own thread
+ *
+ *        Version:  1.0
+ *        Created:  21.10.2026 14:22:50
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "present.hpp"
+
+Presenter::Presenter(PresentBackend &backend, int width, int height, int num_buffers,
+                     double target_fps, PixelFormat format) :
+    backend(backend), width(width), height(height), grid(width, height)
+{
+    for(int i = 0; i < std::max(num_buffers, 1); i++) {
+        buffers.push_back(std::make_unique<Framebuffer>(width, height, format));
+        free_buffers.push_back(i);
+    }
+    buffer_frame.assign(buffers.size(), -1);
+    damage.resize(buffers.size());
+
+    for(int i = 0; i < 2; i++) {
+        staging[i].resize(size_t(width) * height * 4);
+        stale[i].assign(grid.numTiles(), 1);
+    }
+    unpresented.assign(grid.numTiles(), 1);
+
+    frame_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(target_fps > 0 ? 1.0 / target_fps : 0.0));
+    next_frame = std::chrono::steady_clock::now();
+    converter = std::thread(&Presenter::convert, this);
+}
+
+Presenter::~Presenter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    frame_queued.notify_all();
+    // The converter drains the queue first, the last frame is still shown
+    converter.join();
+    presentLatest();
+}
+
+Framebuffer& Presenter::beginFrame()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    buffer_free.wait(lock, [this]() { return !free_buffers.empty(); });
+    rendering = free_buffers.front();
+    free_buffers.pop_front();
+    lock.unlock();
+
+    catchUp(rendering);
+    buffers[rendering]->resetDirty();
+    return *buffers[rendering];
+}
+
+// Brings a buffer from the frame it last held to the newest one. The newest
+// buffer may be converted meanwhile, both only read it.
+void Presenter::catchUp(int idx)
+{
+    if(latest < 0 or latest == idx) return;
+
+    Framebuffer &fb = *buffers[idx];
+    const Framebuffer &src = *buffers[latest];
+    long age = frame_number - buffer_frame[idx];
+    bool all = buffer_frame[idx] < 0 or age - 1 > long(recent.size());
+
+    std::vector<uint8_t> copy(grid.numTiles(), all);
+    if(!all) {
+        for(size_t i = recent.size() - (age - 1); i < recent.size(); i++) {
+            for(int t = 0; t < grid.numTiles(); t++) copy[t] |= recent[i][t];
+        }
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int t = 0; t < grid.numTiles(); t++) {
+        if(copy[t]) fb.copyTile(src, t);
+    }
+}
+
+void Presenter::endFrame()
+{
+    if(rendering >= 0) {
+        Framebuffer &fb = *buffers[rendering];
+        auto &mask = damage[rendering];
+        mask.resize(grid.numTiles());
+        for(int t = 0; t < grid.numTiles(); t++) mask[t] = fb.tileDirty(t);
+
+        recent.push_back(mask);
+        if(recent.size() > buffers.size()) recent.pop_front();
+        buffer_frame[rendering] = frame_number++;
+        latest = rendering;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(rendering);
+        rendering = -1;
+    }
+    frame_queued.notify_one();
+
+    presentLatest();
+
+    if(frame_interval.count() > 0) {
+        auto now = std::chrono::steady_clock::now();
+        next_frame += frame_interval;
+        if(next_frame < now - frame_interval) {
+            // Fell behind by more than a frame, do not try to catch up
+            next_frame = now;
+        }
+        std::this_thread::sleep_until(next_frame);
+    }
+}
+
+void Presenter::presentLatest()
+{
+    std::lock_guard<std::mutex> lock(staging_mutex);
+    if(!front_ready) return;
+    auto rects = grid.mergeRects([this](int t) { return unpresented[t] != 0; });
+    backend.presentRects(staging[front].data(), 4 * width, rects);
+    std::fill(unpresented.begin(), unpresented.end(), 0);
+    front_ready = false;
+    frames_presented++;
+}
+
+void Presenter::convert()
+{
+    while(true) {
+        int idx;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frame_queued.wait(lock, [this]() { return stopping or !queued.empty(); });
+            if(queued.empty()) return;
+            idx = queued.front();
+            queued.pop_front();
+        }
+
+        const auto &changed = damage[idx];
+
+        // Only this thread writes the back buffer and the stale masks
+        int back = 1 - front;
+        for(int i = 0; i < 2; i++) {
+            for(int t = 0; t < grid.numTiles(); t++) stale[i][t] |= changed[t];
+        }
+        auto &image = buffers[idx]->getImage();
+        auto rects = grid.mergeRects([this, back](int t) { return stale[back][t] != 0; });
+        for(const TileRect &r : rects) {
+            image.encodeRect(r.y0, r.x0, r.y1, r.x1,
+                             staging[back].data() + (size_t(r.y0) * width + r.x0) * 4,
+                             4 * width, 4);
+        }
+        std::fill(stale[back].begin(), stale[back].end(), 0);
+
+        {
+            std::lock_guard<std::mutex> lock(staging_mutex);
+            for(int t = 0; t < grid.numTiles(); t++) unpresented[t] |= changed[t];
+            if(front_ready) frames_dropped++;
+            front = back;
+            front_ready = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free_buffers.push_back(idx);
+        }
+        buffer_free.notify_one();
+    }
+}
@@ -0,0 +1,147 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  present.hpp
+ *
+ *    Description:  Buffered presentation of frames with conversion on its own thread
+ *
+ *        Version:  1.0
+ *        Created:  21.10.2026 14:22:50
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef PRESENT_HPP
+#define PRESENT_HPP
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+#include "framebuffer.hpp"
+
+// Receives finished frames as 4 byte sRGB RGBA pixels. Called on the
+// thread that calls Presenter::endFrame, so window system calls are safe.
+class PresentBackend
+{
+public:
+    virtual ~PresentBackend() { }
+    virtual void present(const uchar *pixels, int pitch) = 0;
+    // Only `rects` differ from the previously presented frame, `pixels`
+    // still holds the whole frame
+    virtual void presentRects(const uchar *pixels, int pitch,
+                              const std::vector<TileRect> &/*rects*/)
+    {
+        present(pixels, pitch);
+    }
+    // True once the user asked to close the output
+    virtual bool pollQuit() { return false; }
+};
+
+// For machines without a display. Frames go to an optional callback,
+// e.g. a frame writer, or are dropped.
+class HeadlessBackend : public PresentBackend
+{
+public:
+    using FrameCallback = std::function<void(const uchar *pixels, int pitch)>;
+
+private:
+    FrameCallback callback;
+
+public:
+    HeadlessBackend(FrameCallback callback = FrameCallback()) : callback(callback) { }
+
+    void present(const uchar *pixels, int pitch) override
+    {
+        if(callback) callback(pixels, pitch);
+    }
+};
+
+// Renders into one of `num_buffers` framebuffers while earlier frames are
+// converted on a background thread and shown by the backend.
+//
+//     Framebuffer &fb = presenter.beginFrame();
+//     ... render into fb ...
+//     presenter.endFrame();
+//
+// endFrame() hands the buffer over, shows the newest converted frame and
+// waits for the next frame slot when a target rate is set. If conversion
+// outpaces presentation older converted frames are dropped, if rendering
+// outpaces conversion beginFrame() blocks until a buffer is free.
+//
+// beginFrame() returns a buffer holding the previous frame: tiles written
+// since that buffer was last used are copied over from the newest one.
+// Its dirty tiles are then exactly what the new frame changes, and only
+// those are converted and handed to the backend.
+class Presenter
+{
+    PresentBackend &backend;
+    int width, height;
+    TileGrid grid;
+
+    std::vector<std::unique_ptr<Framebuffer>> buffers;
+    std::deque<int> free_buffers;
+    std::deque<int> queued;
+    int rendering = -1;
+
+    // Converted frames: the converter fills back, endFrame shows front
+    std::vector<uchar> staging[2];
+    int front = 0;
+    bool front_ready = false;
+
+    // Per tile change masks of the last frames, oldest first, and the
+    // frame each buffer was last rendered in (-1 if never)
+    std::deque<std::vector<uint8_t>> recent;
+    std::vector<long> buffer_frame;
+    std::vector<std::vector<uint8_t>> damage;   // per buffer, of its queued frame
+    long frame_number = 0;
+    int latest = -1;
+
+    std::vector<uint8_t> stale[2];      // tiles each staging buffer lacks
+    std::vector<uint8_t> unpresented;   // tiles the backend has not seen
+
+    bool stopping = false;
+    std::mutex mutex;
+    std::mutex staging_mutex;
+    std::condition_variable buffer_free;
+    std::condition_variable frame_queued;
+    std::thread converter;
+
+    std::chrono::steady_clock::duration frame_interval;
+    std::chrono::steady_clock::time_point next_frame;
+
+    size_t frames_presented = 0;
+    size_t frames_dropped = 0;
+
+    void convert();
+    void presentLatest();
+    void catchUp(int idx);
+
+public:
+    // target_fps = 0 disables pacing (e.g. when the backend waits for vsync)
+    Presenter(PresentBackend &backend, int width, int height, int num_buffers = 2,
+              double target_fps = 60.0, PixelFormat format = PixelFormat::RGBA8_SRGB);
+    ~Presenter();
+
+    Presenter(const Presenter&) = delete;
+    Presenter& operator=(const Presenter&) = delete;
+
+    Framebuffer& beginFrame();
+    void endFrame();
+
+    bool shouldQuit() { return backend.pollQuit(); }
+    size_t framesPresented() const { return frames_presented; }
+    size_t framesDropped() const { return frames_dropped; }
+};
+
+#endif
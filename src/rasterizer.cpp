@@ -23,80 +23,23 @@
 
 using tmath::Vec3;
 
-Vertex vertex2screen(Vertex &v, int w, int h) {
-    float cx = v.position[0];
-    float cy = v.position[1];
-    Vec3 pos({
-            (cx+1.0f) * 0.5f * w,
-            (1.0f-cy) * 0.5f * h,
-            v.position[2]
-            });
-
-    return Vertex({pos , v.attr});
+template<>
+void rasterize_triangle<FramebufferPipeline>(Triangle tri, const PartialFSH &fsh, Framebuffer &fb)
+{
+    if(fb.depthEnabled()) {
+        rasterize_triangle<OpaquePipeline>(tri, fsh, fb);
+    } else {
+        rasterize_triangle<NoDepthPipeline>(tri, fsh, fb);
+    }
 }
 
-
-void rasterize_triangle(Triangle tri, PartialFSH fsh, Framebuffer &fb)
+void rasterize_depth(const Vec3 &a, const Vec3 &b, const Vec3 &c, DepthMap &depth)
 {
-    int w = fb.getWidth();
-    int h = fb.getHeight();
-
-    std::array<Vertex, 3> points = {
-        vertex2screen(std::get<0>(tri), w, h),
-        vertex2screen(std::get<1>(tri), w, h),
-        vertex2screen(std::get<2>(tri), w, h)
-    };
-
-    auto intersect_line = [&points](int y) -> PointVariant
-    {
-        int num_int = 0;
-        std::array<Vertex, 3> res_verts;
-
-        for(int i = 0; i < 3; i++) {
-            auto &v1 = points[i];
-            auto &v2 = points[(i+1) % 3];
-            auto &p1 = v1.position;
-            auto &p2 = v2.position;
-
-            if((p1.y() - y) * (p2.y() - y) > 0) continue;
-            // x = (x1-x2)y - x1y2 + x2y1 / (y1 - y2)
-            float t = (y - p1.y()) / (p2.y() - p1.y());
-            if(t < 0.001) continue;
-
-            res_verts[num_int] = interpolate(v1, v2, t);
-            res_verts[num_int].position[1] = y;
-            num_int++;
-            // Edge condition: intersection with point
-        }
-
-        if(num_int == 2) {
-            if(res_verts[0].position.x() > res_verts[1].position.x()) {
-                return std::make_pair(res_verts[1], res_verts[0]);
-            } else {
-                return std::make_pair(res_verts[0], res_verts[1]);
-            }
-        } else if(num_int == 1) {
-            return res_verts[0];
-        }
-
-        return std::monostate();
-    };
-
-    std::sort(points.begin(), points.end(), [](Vertex &p1, Vertex &p2) {
-                return p1.position[1] < p2.position[1];
-            });
-
-    
-
-
-    int y_begin = points[0].position.y();
-    int y_end = points[2].position.y();
-
-    LineRasterizer rast(fb, fsh);
-    y_begin = std::clamp(y_begin, 0, h-1);
-    y_end = std::clamp(y_end, 0, h-1);
-    for(int y = y_begin; y < y_end; y++) {
-        PointVariant inter = intersect_line(y);
-        std::visit(rast, inter);
-    }
+    float *data = depth.getRawData();
+    int w = depth.getWidth();
+    scan_triangle(a, b, c, w, depth.getHeight(), [data, w](int x, int y, float z) {
+        if(z > 1.0f) return;
+        float &d = data[size_t(y) * w + x];
+        if(z < d) d = z;
+    });
 }
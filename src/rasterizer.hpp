@@ -20,6 +20,7 @@
 #define RASTERIZER_HPP
 
 #include <array>
+#include <cmath>
 #include <algorithm>
 #include <functional>
 
@@ -39,53 +40,373 @@ struct ScreenPoint
 using PointPair = std::pair<Vertex, Vertex>;
 using PointVariant = std::variant<std::monostate, Vertex, PointPair>;
 
+// Number of varyings that means every attribute of the vertices
+const int ALL_VARYINGS = -1;
+
+// Passing fragments against the stored depth
+enum class DepthFunc
+{
+    Less,
+    Equal           // after a depth prepass, only the nearest one
+};
+
+// Fixed function state of a draw. Each combination is its own raster
+// kernel, so a pass only pays for what it uses: a depth only pass never
+// interpolates attributes or calls the fragment shader. VARYINGS is the
+// number of leading vertex attributes the fragment shader gets.
+template<bool DEPTH_TEST, bool DEPTH_WRITE, bool STENCIL_WRITE, bool COLOR_WRITE,
+         BlendMode BLEND = BlendMode::Replace, int VARYINGS = ALL_VARYINGS,
+         DepthFunc DEPTH_FUNC = DepthFunc::Less>
+struct PipelineState
+{
+    static constexpr bool depth_test = DEPTH_TEST;
+    static constexpr DepthFunc depth_func = DEPTH_FUNC;
+    static constexpr bool depth_write = DEPTH_WRITE;
+    static constexpr bool stencil_write = STENCIL_WRITE;
+    static constexpr bool color_write = COLOR_WRITE;
+    static constexpr BlendMode blend = BLEND;
+    static constexpr int varyings = COLOR_WRITE ? VARYINGS : 0;
+};
+
+using OpaquePipeline = PipelineState<true, true, true, true>;
+using NoDepthPipeline = PipelineState<false, false, true, true>;
+using DepthOnlyPipeline = PipelineState<true, true, false, false>;
+using TransparentPipeline = PipelineState<true, false, true, true, BlendMode::Alpha>;
+// Accumulates into the framebuffer's OIT buffers in any order, see setOIT
+using OITPipeline = PipelineState<true, false, false, true, BlendMode::WeightedOIT>;
+// Second pass of a depth prepass, shades what the first one left visible
+using EqualDepthPipeline = PipelineState<true, false, true, true, BlendMode::Replace,
+                                         ALL_VARYINGS, DepthFunc::Equal>;
+
+// Takes the state from the framebuffer at draw time: OpaquePipeline with
+// the depth test enabled, NoDepthPipeline without
+struct FramebufferPipeline { };
+
+// The first `N` attributes, all for ALL_VARYINGS
+template<int N>
+inline AttribVec interpolate_varyings(const AttribVec &v1, const AttribVec &v2, float t)
+{
+    if constexpr(N == 0) {
+        return AttribVec();
+    } else {
+        size_t n = N == ALL_VARYINGS ? v1.size() : std::min(size_t(N), v1.size());
+        AttribVec res(n);
+        for(size_t i = 0; i < n; i++) {
+            res[i] = interp_attr(v1[i], v2[i], t);
+        }
+        return res;
+    }
+}
+
+// Writes only inside `scissor`. Shaded fragments are counted locally and
+// added to the framebuffer once, so tiles can be rasterized in parallel.
+template<typename State>
 struct LineRasterizer
 {
 private:
     Framebuffer &fb;
-    PartialFSH fsh;
+    const PartialFSH &fsh;
+    TileRect scissor;
+    size_t fragments = 0;
 public:
-    LineRasterizer(Framebuffer &fb, PartialFSH fsh) :
-        fb(fb), fsh(fsh)
+    LineRasterizer(Framebuffer &fb, const PartialFSH &fsh, const TileRect &scissor) :
+        fb(fb), fsh(fsh), scissor(scissor)
     { }
 
+    ~LineRasterizer() { fb.countFragment(fragments); }
+
+    LineRasterizer(const LineRasterizer&) = delete;
+    LineRasterizer& operator=(const LineRasterizer&) = delete;
+
+    static constexpr bool blends = State::color_write and State::blend != BlendMode::Replace;
+
+    // The writes of a passing fragment but the colour, which is returned
+    RGBAColor fragment(int x, int y, float z, const AttribVec &attr)
+    {
+        if constexpr(State::depth_write) fb.putDepth(x, y, z);
+        if constexpr(State::stencil_write) fb.putStencil(x, y, 1);
+        RGBAColor color;
+        if constexpr(State::color_write) {
+            fragments++;
+            color = fsh(attr);
+        }
+        if constexpr(State::varyings == ALL_VARYINGS or State::varyings >= 2) {
+            if(fb.varyingAttribsEnabled()) {
+                fb.putAttrib(x, y, FragAttrib({ std::get<Vec3>(attr[0]),
+                                                tmath::normalize(std::get<Vec3>(attr[1])) }));
+            }
+        }
+        return color;
+    }
+
+    RGBAColor fragment(int x, int y, float z, const PointPair &p, float t)
+    {
+        if constexpr(State::varyings == 0) {
+            return fragment(x, y, z, p.first.attr);
+        } else {
+            ArenaMark pixel_scope;
+            AttribVec cur_attr = interpolate_varyings<State::varyings>(p.first.attr,
+                                                                       p.second.attr, t);
+            return fragment(x, y, z, cur_attr);
+        }
+    }
+
+    // `n` shaded fragments of row y from x, as RGBA floats. Pixels that
+    // failed the test hold transparent black, which changes nothing.
+    void blendSpan(int y, int x, int n, const float *colors, const float *depths)
+    {
+        if constexpr(State::blend == BlendMode::WeightedOIT) {
+            if(fb.oitEnabled()) fb.accumulateOIT(y, x, n, colors, depths);
+        } else {
+            FrameVector<float> dst(n * 4);
+            for(int i = 0; i < n; i++) {
+                RGBAColor d = fb.getPixel(x + i, y);
+                for(int c = 0; c < 4; c++) dst[i*4 + c] = d[c];
+            }
+            blend_span<State::blend>(colors, dst.data(), n);
+            for(int i = 0; i < n; i++) {
+                const float *src = colors + i*4;
+                if(src[0] == 0.0f and src[1] == 0.0f and src[2] == 0.0f and src[3] == 0.0f) continue;
+                fb.putColor(x + i, y, RGBAColor({dst[i*4], dst[i*4+1], dst[i*4+2], dst[i*4+3]}));
+            }
+        }
+    }
+
+    bool test(int x, int y, float z)
+    {
+        if(z < -1.0f or z > 1.0f) return false;
+        if constexpr(State::depth_test and State::depth_func == DepthFunc::Equal) {
+            return z == fb.getDepthValue(x, y);
+        } else if constexpr(State::depth_test) {
+            return z < fb.getDepthValue(x, y);
+        }
+        return true;
+    }
+
     void operator() (PointPair &p)
     {
         int y = p.first.position.y();
-        if(y < 0 or y > fb.getHeight()) return;
-        int x1 = round(p.first.position[0]);
-        int x2 = round(p.second.position[0]);
+        if(y < scissor.y0 or y >= scissor.y1) return;
+        float xl = p.first.position[0];
+        float xr = p.second.position[0];
 
-        int z1 = p.first.position[2];
-        int z2 = p.second.position[2];
+        float z1 = p.first.position[2];
+        float z2 = p.second.position[2];
 
-        if(x2 < 0 or x1 > fb.getWidth() - 1) return;
+        // Pixels whose centre lies in [xl, xr)
+        float x0 = scissor.x0, x1 = scissor.x1;
+        int x_begin = std::clamp(std::ceil(xl - 0.5f), x0, x1);
+        int x_end = std::clamp(std::ceil(xr - 0.5f), x0, x1);
+        if(x_begin >= x_end) return;
 
-        int cx1 = std::clamp(x1, 0, fb.getWidth()-1);
-        int cx2 = std::clamp(x2, 0, fb.getWidth()-1);
-        for(int x = cx1; x <= cx2; x++) {
-            float t = float(x - x1) / (x2 - x1);
+        // Blended rows are shaded first and blended in one pass
+        int n = blends ? x_end - x_begin : 0;
+        FrameVector<float> colors(n * 4, 0.0f);
+        FrameVector<float> depths(n, 0.0f);
+
+        for(int x = x_begin; x < x_end; x++) {
+            float t = (x + 0.5f - xl) / (xr - xl);
             float z = (1.0f-t) * z1 + t * z2;
 
-            if(z < -1.0f or z > 1.0f) continue;
+            // Before shading, hidden fragments cost only the test
+            if(!test(x, y, z)) continue;
 
-            AttribVec cur_attr = interpolate(p.first.attr, p.second.attr, t);
-            fb.putPixel(x, y, z, fsh(cur_attr));
+            RGBAColor color = fragment(x, y, z, p, t);
+            if constexpr(blends) {
+                int i = x - x_begin;
+                depths[i] = z;
+                for(int c = 0; c < 4; c++) colors[i*4 + c] = color[c];
+            } else if constexpr(State::color_write) {
+                fb.putColor(x, y, color);
+            }
         }
+        if constexpr(blends) blendSpan(y, x_begin, n, colors.data(), depths.data());
     }
 
     void operator() (Vertex &point)
     {
         int x = point.position[0];
-        if(x < 0 or x > fb.getWidth()) return;
-        fb.putPixel(point.position, fsh(point.attr));
+        int y = point.position[1];
+        float z = point.position[2];
+        if(x < scissor.x0 or x >= scissor.x1 or y < scissor.y0 or y >= scissor.y1) return;
+        if(!test(x, y, z)) return;
+
+        RGBAColor color = fragment(x, y, z, point.attr);
+        if constexpr(blends) {
+            float c[4] = { color[0], color[1], color[2], color[3] };
+            blendSpan(y, x, 1, c, &z);
+        } else if constexpr(State::color_write) {
+            fb.putColor(x, y, color);
+        }
     }
 
     void operator() (std::monostate&) { }
 };
 
+inline Vertex vertex2screen(const Vertex &v, int w, int h)
+{
+    float cx = v.position[0];
+    float cy = v.position[1];
+    Vec3 pos({
+            (cx+1.0f) * 0.5f * w,
+            (1.0f-cy) * 0.5f * h,
+            v.position[2]
+            });
+
+    return Vertex({pos , v.attr});
+}
+
+// Rows are sampled at pixel centres. An edge covers the half open range
+// [min y, max y), so a row through a shared vertex meets exactly two
+// edges. Only the varyings of State are carried along.
+template<typename State>
+PointVariant intersect_row(const std::array<Vertex, 3> &points, int y)
+{
+    float yc = y + 0.5f;
+    int num_int = 0;
+    std::array<Vertex, 3> res_verts;
+
+    for(int i = 0; i < 3; i++) {
+        const Vertex &v1 = points[i];
+        const Vertex &v2 = points[(i+1) % 3];
+        float x1 = v1.position[0], y1 = v1.position[1], z1 = v1.position[2];
+        float x2 = v2.position[0], y2 = v2.position[1], z2 = v2.position[2];
+
+        if(yc < std::min(y1, y2) or yc >= std::max(y1, y2)) continue;
+        float t = (yc - y1) / (y2 - y1);
+
+        res_verts[num_int].position = Vec3({(1.0f - t) * x1 + t * x2, float(y),
+                                            (1.0f - t) * z1 + t * z2});
+        res_verts[num_int].attr = interpolate_varyings<State::varyings>(v1.attr, v2.attr, t);
+        num_int++;
+    }
+
+    if(num_int == 2) {
+        if(res_verts[0].position.x() > res_verts[1].position.x()) {
+            return std::make_pair(res_verts[1], res_verts[0]);
+        } else {
+            return std::make_pair(res_verts[0], res_verts[1]);
+        }
+    } else if(num_int == 1) {
+        return res_verts[0];
+    }
+
+    return std::monostate();
+}
+
+// Takes the vertices in screen space, as vertex2screen gives them, and
+// reorders them. Only pixels inside `scissor` are written.
+template<typename State>
+void rasterize_screen_triangle(std::array<Vertex, 3> &points, const PartialFSH &fsh,
+                               Framebuffer &fb, const TileRect &scissor)
+{
+    std::sort(points.begin(), points.end(), [](const Vertex &p1, const Vertex &p2) {
+                return p1.position[1] < p2.position[1];
+            });
+
+    // Rows whose centre lies in [y0, y2)
+    float y0 = scissor.y0, y1 = scissor.y1;
+    float y_first = std::clamp(std::ceil(points[0].position.y() - 0.5f), y0, y1);
+    float y_last = std::clamp(std::ceil(points[2].position.y() - 0.5f), y0, y1);
+    int y_begin = y_first;
+    int y_end = y_last;
+
+    // For dFdx and dFdy in the fragment shader
+    FragmentContext ctx = {
+        { &points[0].position, &points[1].position, &points[2].position },
+        { points[0].attr.data(), points[1].attr.data(), points[2].attr.data() },
+        State::varyings == ALL_VARYINGS ? points[0].attr.size()
+            : std::min(size_t(State::varyings), points[0].attr.size())
+    };
+    FragmentScope fragment_scope(State::color_write ? &ctx : nullptr);
+
+    LineRasterizer<State> rast(fb, fsh, scissor);
+    for(int y = y_begin; y < y_end; y++) {
+        ArenaMark line_scope;
+        PointVariant inter = intersect_row<State>(points, y);
+        std::visit(rast, inter);
+    }
+}
+
+// The triangle's vertices are in NDC, as the vertex shader returns them
+template<typename State>
+void rasterize_triangle(Triangle tri, const PartialFSH &fsh, Framebuffer &fb)
+{
+    int w = fb.getWidth();
+    int h = fb.getHeight();
+
+    std::array<Vertex, 3> points = {
+        vertex2screen(std::get<0>(tri), w, h),
+        vertex2screen(std::get<1>(tri), w, h),
+        vertex2screen(std::get<2>(tri), w, h)
+    };
+    rasterize_screen_triangle<State>(points, fsh, fb, TileRect({0, 0, w, h}));
+}
+
+template<>
+void rasterize_triangle<FramebufferPipeline>(Triangle tri, const PartialFSH &fsh, Framebuffer &fb);
+
 bool facing_forward(const Triangle &tri);
 
-void rasterize_triangle(Triangle tri, PartialFSH fsh, Framebuffer &fb);
+inline void rasterize_triangle(Triangle tri, const PartialFSH &fsh, Framebuffer &fb)
+{
+    rasterize_triangle<FramebufferPipeline>(tri, fsh, fb);
+}
+
+// Calls fragment(x, y, z) for every pixel of a width x height target
+// whose centre the triangle covers, either winding. Takes screen
+// positions, z is interpolated linearly.
+template<typename Fragment>
+void scan_triangle(const Vec3 &a, const Vec3 &b, const Vec3 &c, int width, int height,
+                   Fragment fragment)
+{
+    float ax = a[0], ay = a[1], az = a[2];
+    float bx = b[0], by = b[1], bz = b[2];
+    float cx = c[0], cy = c[1], cz = c[2];
+
+    float area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+    if(area == 0.0f) return;
+
+    int x0 = std::max(int(std::ceil(std::min({ax, bx, cx}) - 0.5f)), 0);
+    int x1 = std::min(int(std::ceil(std::max({ax, bx, cx}) - 0.5f)), width);
+    int y0 = std::max(int(std::ceil(std::min({ay, by, cy}) - 0.5f)), 0);
+    int y1 = std::min(int(std::ceil(std::max({ay, by, cy}) - 0.5f)), height);
+    if(x0 >= x1 or y0 >= y1) return;
+
+    float s = area > 0.0f ? 1.0f : -1.0f;
+    float inv_area = 1.0f / std::abs(area);
+
+    // Edge functions step by a constant per pixel
+    float e0_dx = -(cy - by) * s, e0_dy = (cx - bx) * s;
+    float e1_dx = -(ay - cy) * s, e1_dy = (ax - cx) * s;
+    float e2_dx = -(by - ay) * s, e2_dy = (bx - ax) * s;
+    float px = x0 + 0.5f, py = y0 + 0.5f;
+    float e0_row = ((cx - bx) * (py - by) - (cy - by) * (px - bx)) * s;
+    float e1_row = ((ax - cx) * (py - cy) - (ay - cy) * (px - cx)) * s;
+    float e2_row = ((bx - ax) * (py - ay) - (by - ay) * (px - ax)) * s;
+
+    for(int y = y0; y < y1; y++) {
+        float e0 = e0_row, e1 = e1_row, e2 = e2_row;
+        for(int x = x0; x < x1; x++) {
+            if(e0 >= 0.0f and e1 >= 0.0f and e2 >= 0.0f) {
+                // e0 weighs the vertex opposite to edge b-c
+                fragment(x, y, (e0 * az + e1 * bz + e2 * cz) * inv_area);
+            }
+            e0 += e0_dx;
+            e1 += e1_dx;
+            e2 += e2_dx;
+        }
+        e0_row += e0_dy;
+        e1_row += e1_dy;
+        e2_row += e2_dy;
+    }
+}
+
+// Depth only path for shadow maps and prepasses: no attributes and no
+// fragment shader. Takes screen positions with NDC depth in z, samples
+// pixel centres like rasterize_triangle and keeps the nearest depth.
+// Fragments past the far plane are dropped, the near plane has to be
+// clipped by the caller (see draw_depth).
+void rasterize_depth(const Vec3 &a, const Vec3 &b, const Vec3 &c, DepthMap &depth);
 
 #endif
@@ -23,6 +23,7 @@
 #include <optional>
 
 #include "draw.hpp"
+#include "camera.hpp"
 #include "math/vector.hpp"
 #include "math/matrix.hpp"
 #include "math/transform.hpp"
@@ -43,6 +44,10 @@ using MaybeResult = std::optional<TraceResult>;
 using TraceFunc = std::function<MaybeResult(const Vec3 &, const Vec3 &)>;
 using DistanceFunc = std::function<float(Vec3)>;
 
+// Like TraceFunc for a unit direction, but gives up past `max_distance`
+using BoundedTraceFunc = std::function<MaybeResult(const Vec3 &origin, const Vec3 &dir,
+                                                   float max_distance)>;
+
 
 inline Vec3 sdf_normal(DistanceFunc d, Vec3 point)
 {
@@ -55,7 +60,8 @@ inline Vec3 sdf_normal(DistanceFunc d, Vec3 point)
     return normalize(res);
 }
 
-inline void trace(Framebuffer &fb, TraceFunc f, float fov, const Vec3 &pos, const Quat &rot)
+template<typename FB>
+inline void trace(FB &fb, TraceFunc f, float fov, const Vec3 &pos, const Quat &rot)
 {
     int w = fb.getWidth();
     int h = fb.getHeight();
@@ -86,4 +92,70 @@ inline void trace(Framebuffer &fb, TraceFunc f, float fov, const Vec3 &pos, cons
     }
 }
 
+// Sphere tracing, the distance along `dir` (unit) to the surface of `d`
+inline std::optional<float> sdf_march(DistanceFunc d, const Vec3 &origin, const Vec3 &dir,
+                                      float max_distance, int max_steps = 64,
+                                      float epsilon = 0.0001f)
+{
+    float t = 0.0f;
+    for(int i = 0; i < max_steps and t < max_distance; i++) {
+        float dist = d(origin + t * dir);
+        if(dist < epsilon) return t;
+        t += dist;
+    }
+    return std::nullopt;
+}
+
+struct HybridStats
+{
+    size_t pixels = 0;
+    size_t raster_covered = 0;  // rays cut short by a triangle
+    size_t sdf_hits = 0;        // pixels where the SDF was closer
+};
+
+// Second half of the hybrid pipeline: meshes are rasterized first with
+// cam.view() and cam.projection(), then every pixel marches only up to
+// the raster surface. Closer SDF hits overwrite colour, depth (as NDC
+// depth, like the rasterizer) and attributes, so lighting sees one
+// merged G-buffer. Untouched pixels must have depth outside [-1, 1]
+// (clearAll's default does).
+template<typename FB>
+HybridStats trace_hybrid(FB &fb, BoundedTraceFunc f, const Camera &cam)
+{
+    int w = fb.getWidth();
+    int h = fb.getHeight();
+    size_t covered = 0, hits = 0;
+
+    #pragma omp parallel for schedule(dynamic) reduction(+:covered, hits)
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            // ray() has unit length along the axis, so view depth times
+            // its length is distance along the ray
+            Vec3 ray = cam.ray(x, y, w, h);
+            float len = length(ray);
+            Vec3 dir = ray / len;
+
+            float depth = fb.getDepthValue(x, y);
+            bool raster = depth >= -1.0f and depth <= 1.0f;
+            float max_depth = raster ? cam.viewDepth(depth) : cam.far;
+            covered += raster;
+
+            auto res = f(cam.pos, dir, max_depth * len);
+            if(!res or res->depth >= max_depth * len) continue;
+            float view_depth = res->depth / len;
+            if(view_depth < cam.near) continue;
+
+            hits++;
+            fb.putPixel(x, y, cam.ndcDepth(view_depth), res->color);
+            fb.putAttrib(x, y, FragAttrib({cam.pos + res->depth * dir, res->normal}));
+        }
+    }
+
+    HybridStats stats;
+    stats.pixels = size_t(w) * h;
+    stats.raster_covered = covered;
+    stats.sdf_hits = hits;
+    return stats;
+}
+
 #endif
@@ -0,0 +1,72 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  relight.cpp
+ *
+ *    Description:  Lights a G-buffer dump with a point light without re-tracing
+ *
+ *        Version:  1.0
+ *        Created:  21.10.2026 11:05:37
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include <chrono>
+#include <iostream>
+
+#include "gbuffer.hpp"
+#include "lighting.hpp"
+
+// relight <in.gbuf> <out.pfm|out.ppm|out.png> <x> <y> <z> [strength]
+// The light defaults to the camera position of the dump.
+int main(int argc, char **argv)
+{
+    if(argc < 3) {
+        std::cout << "Usage: " << argv[0]
+                  << " <in.gbuf> <out.pfm|ppm|png> [light_x light_y light_z [strength]]\n";
+        return 1;
+    }
+
+    MappedGBuffer gbuf(argv[1]);
+    if(!gbuf.isOpen()) return 1;
+
+    Vec3 cam_pos = gbuf.getCameraPos();
+    PointLight light;
+    light.pos = cam_pos;
+    light.strength = 45;
+    if(argc >= 6) {
+        light.pos = Vec3({std::stof(argv[3]), std::stof(argv[4]), std::stof(argv[5])});
+    }
+    if(argc >= 7) {
+        light.strength = std::stof(argv[6]);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    int w = gbuf.getWidth();
+    int h = gbuf.getHeight();
+    Framebuffer out(w, h, PixelFormat::RGBA32F);
+    out.clearAll(RGBAColor({0,0,0,1}));
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            if(!gbuf.stencil(y,x)) continue;
+            RGBAColor color = phong_shade(light, cam_pos, gbuf.position(y,x),
+                                          gbuf.normal(y,x), gbuf.color(y,x));
+            out.putPixel(x, y, gbuf.depth(y,x), color);
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Relit " << w << "x" << h << " in "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+
+    out.Save(argv[2]);
+    return 0;
+}
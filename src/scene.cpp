@@ -0,0 +1,255 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  scene.cpp
+ *
+ *    Description:  Collection of placed models with a BVH for visibility culling
+ *
+ *        Version:  1.0
+ *        Created:  23.10.2026 15:12:09
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "scene.hpp"
+
+#include <algorithm>
+
+#include "lod.hpp"
+#include "draw.hpp"
+#include "math/transform.hpp"
+
+const int BVH_LEAF_SIZE = 4;
+
+// Rebuild once refitting has grown the root this much
+const float BVH_REBUILD_GROWTH = 2.0f;
+
+AABB model_aabb(const Model &model)
+{
+    AABB box;
+    const VertexBuffer &vb = model.vertices;
+    for(size_t i = 0; i < vb.size(); i++) {
+        const float *p = vb.vertex(i);
+        box.extend(Vec3({p[0], p[1], p[2]}));
+    }
+    return box;
+}
+
+int Scene::add(const Model &model, Shader shader, const Mat4 &transform,
+               bool occluder, const UniformVec &uniforms)
+{
+    auto it = model_bounds.find(&model);
+    if(it == model_bounds.end()) {
+        it = model_bounds.emplace(&model, model_aabb(model)).first;
+    }
+
+    objects.push_back({&model, shader, transform, uniforms, occluder,
+                       it->second.transformed(transform)});
+    needs_build = true;
+    return objects.size() - 1;
+}
+
+void Scene::setTransform(int id, const Mat4 &transform)
+{
+    SceneObject &obj = objects[id];
+    obj.transform = transform;
+    obj.world = model_bounds[obj.model].transformed(transform);
+    needs_refit = true;
+}
+
+void Scene::buildNode(int index, int first, int count)
+{
+    AABB box, centers;
+    for(int i = first; i < first + count; i++) {
+        box.extend(objects[order[i]].world);
+        centers.extend(objects[order[i]].world.center());
+    }
+    nodes[index].box = box;
+    nodes[index].first = first;
+    nodes[index].count = count;
+
+    if(count <= BVH_LEAF_SIZE) {
+        return;
+    }
+
+    // Median split along the widest spread of the centres
+    Vec3 extent = centers.hi - centers.lo;
+    int axis = 0;
+    if(extent[1] > extent[axis]) axis = 1;
+    if(extent[2] > extent[axis]) axis = 2;
+    int half = count / 2;
+    std::nth_element(order.begin() + first, order.begin() + first + half,
+                     order.begin() + first + count,
+                     [this, axis](int a, int b) {
+                         return objects[a].world.center()[axis] <
+                                objects[b].world.center()[axis];
+                     });
+
+    // Children sit next to each other, after their parent
+    int left = nodes.size();
+    nodes[index].left = left;
+    nodes.resize(left + 2);
+    buildNode(left, first, half);
+    buildNode(left + 1, first + half, count - half);
+}
+
+void Scene::build()
+{
+    nodes.clear();
+    order.resize(objects.size());
+    for(size_t i = 0; i < objects.size(); i++) order[i] = i;
+    if(!objects.empty()) {
+        nodes.resize(1);
+        buildNode(0, 0, objects.size());
+    }
+    built_area = nodes.empty() ? 0.0f : nodes[0].box.area();
+    needs_build = false;
+    needs_refit = false;
+}
+
+void Scene::refit()
+{
+    // Children always come after their parent
+    for(int n = nodes.size() - 1; n >= 0; n--) {
+        Node &node = nodes[n];
+        AABB box;
+        if(node.left < 0) {
+            for(int i = node.first; i < node.first + node.count; i++) {
+                box.extend(objects[order[i]].world);
+            }
+        } else {
+            box.extend(nodes[node.left].box);
+            box.extend(nodes[node.left + 1].box);
+        }
+        node.box = box;
+    }
+    needs_refit = false;
+    if(!nodes.empty() and nodes[0].box.area() > BVH_REBUILD_GROWTH * built_area) {
+        build();
+    }
+}
+
+void Scene::update()
+{
+    if(needs_build) build();
+    else if(needs_refit) refit();
+}
+
+void Scene::cull(const Mat4 &view_proj, std::vector<int> &visible, SceneStats &stats)
+{
+    update();
+    visible.clear();
+    stats.objects = objects.size();
+    if(nodes.empty()) return;
+
+    Frustum frustum(view_proj);
+
+    if(occlusion_culling) {
+        occlusion.clear();
+        for(const SceneObject &obj : objects) {
+            if(!obj.occluder or frustum.classify(obj.world) == Containment::Outside) continue;
+            occlusion.rasterize(*obj.model, view_proj * obj.transform);
+        }
+    }
+
+    // Depth first, a node inside the frustum skips the plane tests of
+    // its subtree
+    std::vector<std::pair<int, bool>> stack = {{0, false}};
+    while(!stack.empty()) {
+        auto [n, inside] = stack.back();
+        stack.pop_back();
+        const Node &node = nodes[n];
+
+        if(!inside) {
+            Containment c = frustum.classify(node.box);
+            if(c == Containment::Outside) {
+                stats.frustum_culled += node.count;
+                continue;
+            }
+            inside = c == Containment::Inside;
+        }
+        if(occlusion_culling and !occlusion.visible(node.box, view_proj)) {
+            stats.occlusion_culled += node.count;
+            continue;
+        }
+
+        if(node.left >= 0) {
+            stack.push_back({node.left + 1, inside});
+            stack.push_back({node.left, inside});
+            continue;
+        }
+
+        for(int i = node.first; i < node.first + node.count; i++) {
+            const SceneObject &obj = objects[order[i]];
+            if(!inside and frustum.classify(obj.world) == Containment::Outside) {
+                stats.frustum_culled++;
+            } else if(occlusion_culling and !occlusion.visible(obj.world, view_proj)) {
+                stats.occlusion_culled++;
+            } else {
+                visible.push_back(order[i]);
+            }
+        }
+    }
+}
+
+// Both passes of a depth prepass take the same path, so they produce
+// the same depths
+template<typename State>
+static void draw_object(const SceneObject &obj, Framebuffer &fbo, const Mat4 &view_proj,
+                        const Vec3 &camera, float lod_pixel_error, SceneStats &stats)
+{
+    UniformVec uni = { obj.transform, view_proj };
+    uni.insert(uni.end(), obj.uniforms.begin(), obj.uniforms.end());
+
+    Mat4 model_to_clip = view_proj * obj.transform;
+    int level = select_lod(*obj.model, model_to_clip, fbo.getHeight(), lod_pixel_error);
+    if(level > 0) {
+        Model lod = lod_view(*obj.model, level);
+        draw_model<State>(lod, obj.shader, fbo, uni);
+        stats.triangles += lod.indices.numTriangles();
+        return;
+    }
+    if(obj.model->meshlets.empty()) {
+        draw_model<State>(*obj.model, obj.shader, fbo, uni);
+        stats.triangles += obj.model->indices.numTriangles();
+        return;
+    }
+    Vec4 local_camera = tmath::affine_inverse(obj.transform) * tmath::toVec4(camera, 1.0f);
+    ClusterCuller culler(model_to_clip, tmath::toVec3(local_camera));
+    DrawStats ds = draw_model<State>(*obj.model, obj.shader, fbo, uni, culler);
+    stats.triangles += ds.triangles;
+    stats.triangles_culled += ds.culled;
+}
+
+SceneStats Scene::draw(Framebuffer &fbo, const Mat4 &view_proj, const Vec3 &camera)
+{
+    SceneStats stats;
+    std::vector<int> visible;
+    cull(view_proj, visible, stats);
+    stats.drawn = visible.size();
+    size_t fragments = fbo.getFragmentCount();
+
+    if(depth_prepass) {
+        SceneStats prepass;
+        for(int id : visible) {
+            draw_object<DepthOnlyPipeline>(objects[id], fbo, view_proj, camera,
+                                           lod_pixel_error, prepass);
+        }
+        for(int id : visible) {
+            draw_object<EqualDepthPipeline>(objects[id], fbo, view_proj, camera,
+                                            lod_pixel_error, stats);
+        }
+    } else {
+        for(int id : visible) {
+            draw_object<FramebufferPipeline>(objects[id], fbo, view_proj, camera,
+                                             lod_pixel_error, stats);
+        }
+    }
+    stats.fragments = fbo.getFragmentCount() - fragments;
+    return stats;
+}
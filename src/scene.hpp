@@ -0,0 +1,121 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  scene.hpp
+ *
+ *    Description:  Collection of placed models with a BVH for visibility culling
+ *
+ *        Version:  1.0
+ *        Created:  23.10.2026 15:12:09
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <vector>
+#include <unordered_map>
+
+#include "model.hpp"
+#include "shader.hpp"
+#include "bounds.hpp"
+#include "occlusion.hpp"
+#include "framebuffer.hpp"
+
+// Bounds of the positions (attribute 0) in model space
+AABB model_aabb(const Model &model);
+
+struct SceneObject
+{
+    const Model *model;
+    Shader shader;
+    Mat4 transform;
+    // Passed to the shaders after the transforms, see Scene::draw
+    UniformVec uniforms;
+    // Rendered into the occlusion buffer before anything is tested
+    bool occluder;
+    AABB world;
+};
+
+struct SceneStats
+{
+    size_t objects = 0;
+    size_t frustum_culled = 0;
+    size_t occlusion_culled = 0;
+    size_t drawn = 0;
+    size_t triangles = 0;           // in drawn objects, at their LOD
+    size_t triangles_culled = 0;    // of those, by meshlet culling
+    size_t fragments = 0;           // fragment shader invocations
+};
+
+class Scene
+{
+    struct Node
+    {
+        AABB box;
+        int left = -1;              // children are left and left + 1
+        int first = 0;              // range in `order`
+        int count = 0;
+    };
+
+    std::vector<SceneObject> objects;
+    std::unordered_map<const Model*, AABB> model_bounds;
+
+    std::vector<Node> nodes;
+    std::vector<int> order;
+    bool needs_build = false;
+    bool needs_refit = false;
+    float built_area = 0.0f;
+
+    OcclusionBuffer occlusion;
+    bool occlusion_culling = true;
+    float lod_pixel_error = 1.0f;
+    bool depth_prepass = false;
+
+    void build();
+    void refit();
+    void buildNode(int index, int first, int count);
+    void update();
+
+public:
+    // The model must outlive the scene. Returns the object id.
+    int add(const Model &model, Shader shader, const Mat4 &transform,
+            bool occluder = false, const UniformVec &uniforms = {});
+
+    // The BVH is refitted on the next cull, and rebuilt once refitting
+    // has loosened it too much
+    void setTransform(int id, const Mat4 &transform);
+
+    const SceneObject& getObject(int id) const { return objects[id]; }
+    size_t size() const { return objects.size(); }
+
+    void setOcclusionCulling(bool flag) { occlusion_culling = flag; }
+    const OcclusionBuffer& getOcclusion() const { return occlusion; }
+
+    // Models with an LOD chain are drawn at the coarsest level that
+    // stays within this many pixels of the full one
+    void setLODPixelError(float pixels) { lod_pixel_error = pixels; }
+
+    // Draws the depth of everything visible first, then shades only
+    // the fragments that match it, see draw_prepassed
+    void setDepthPrepass(bool flag) { depth_prepass = flag; }
+
+    // Ids of the objects that may be visible through `view_proj`:
+    // frustum tests down the BVH, then (if enabled) occlusion tests
+    // against the occluders
+    void cull(const Mat4 &view_proj, std::vector<int> &visible, SceneStats &stats);
+
+    // Culls and draws what is left. Uniform 0 is the model transform,
+    // 1 the view projection, the object's own uniforms follow. Models with
+    // meshlets are culled per meshlet as well (at full detail), which
+    // needs the camera position in world space.
+    SceneStats draw(Framebuffer &fbo, const Mat4 &view_proj, const Vec3 &camera);
+};
+
+#endif
@@ -24,6 +24,8 @@
 #include "math/vector.hpp"
 #include "math/matrix.hpp"
 #include "framebuffer.hpp"
+#include "texture.hpp"
+#include "arena.hpp"
 
 template<class... Ts> struct overload : Ts... { using Ts::operator()...; };
 template<class... Ts> overload(Ts...) -> overload<Ts...>;
@@ -37,9 +39,10 @@ using tmath::Mat4;
 
 using VshInput = std::variant<int, float, bool, Vec3, Vec4>;
 using Attribute = std::variant<float, Vec3, Vec4>;
-using Uniform = std::variant<float, int, Vec3, Vec4, Mat3, Mat4, Framebuffer>;
+using Uniform = std::variant<float, int, Vec3, Vec4, Mat3, Mat4, FramebufferView, TextureView>;
 
-using AttribVec = std::vector<Attribute>;
+// Allocated from the arena of the current thread if one is bound
+using AttribVec = FrameVector<Attribute>;
 using UniformVec = std::vector<Uniform>;
 
 using VertexShader = std::function<Vertex(const AttribVec &attribs,
@@ -86,6 +89,71 @@ inline Attribute interp_attr(const Attribute &a1, const Attribute &a2, float t)
     return res;
 }
 
+// w0 * a + w1 * b + w2 * c, zero of float type if the types differ
+inline Attribute barycentric_attr(const Attribute &a, const Attribute &b, const Attribute &c,
+                                  float w0, float w1, float w2)
+{
+    Attribute res = 0.0f;
+    std::visit(
+        [&](auto &&v0, auto &&v1, auto &&v2) {
+            using T = std::decay_t<decltype(v0)>;
+            if constexpr(std::is_same_v<T, std::decay_t<decltype(v1)>> and
+                         std::is_same_v<T, std::decay_t<decltype(v2)>>) {
+                res = w0 * v0 + w1 * v1 + w2 * v2;
+            }
+        }
+        , a, b, c);
+    return res;
+}
+
+// The triangle a fragment shader runs for: screen positions and the
+// varyings of its vertices. Set by the raster kernels for dFdx and dFdy.
+struct FragmentContext
+{
+    const Vec3 *pos[3];
+    const Attribute *attr[3];
+    size_t num_attribs;
+};
+
+inline thread_local const FragmentContext *current_fragment = nullptr;
+
+// Makes `ctx` the fragment context of this thread for its lifetime
+class FragmentScope
+{
+    const FragmentContext *prev;
+public:
+    FragmentScope(const FragmentContext *ctx) : prev(current_fragment) { current_fragment = ctx; }
+    ~FragmentScope() { current_fragment = prev; }
+    FragmentScope(const FragmentScope&) = delete;
+    FragmentScope& operator=(const FragmentScope&) = delete;
+};
+
+// Varyings are linear over a triangle in screen space, so the
+// differences a 2x2 quad of fragments would take are the same over all
+// of it and follow from the vertices
+inline Attribute fragment_derivative(size_t index, bool along_y)
+{
+    const FragmentContext *ctx = current_fragment;
+    if(!ctx or index >= ctx->num_attribs) return 0.0f;
+
+    const Vec3 &a = *ctx->pos[0], &b = *ctx->pos[1], &c = *ctx->pos[2];
+    const Attribute &va = ctx->attr[0][index];
+    const Attribute &vb = ctx->attr[1][index];
+    const Attribute &vc = ctx->attr[2][index];
+    float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+    if(area == 0.0f) return barycentric_attr(va, vb, vc, 0.0f, 0.0f, 0.0f);
+
+    // Change of the barycentrics of b and c per pixel
+    float w1 = along_y ? -(c[0] - a[0]) / area : (c[1] - a[1]) / area;
+    float w2 = along_y ? (b[0] - a[0]) / area : -(b[1] - a[1]) / area;
+    return barycentric_attr(va, vb, vc, -(w1 + w2), w1, w2);
+}
+
+// Change of varying `index` from one pixel to the next along screen x
+// or y, in a fragment shader. Zero anywhere else.
+inline Attribute dFdx(size_t index) { return fragment_derivative(index, false); }
+inline Attribute dFdy(size_t index) { return fragment_derivative(index, true); }
+
 inline AttribVec interpolate(const AttribVec &v1, const AttribVec &v2, float t)
 {
     using namespace std::placeholders;
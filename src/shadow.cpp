@@ -0,0 +1,174 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  shadow.cpp
+ *
+ *    Description:  Rasterized cube shadow maps for point lights
+ *
+ *        Version:  1.0
+ *        Created:  24.10.2026 14:20:51
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "shadow.hpp"
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#include "draw.hpp"
+#include "scene.hpp"
+#include "math/transform.hpp"
+
+// Forward, right and up of each face: +x, -x, +y, -y, +z, -z
+static const float FACE_AXES[6][3][3] = {
+    {{ 1, 0, 0}, { 0, 0,-1}, { 0, 1, 0}},
+    {{-1, 0, 0}, { 0, 0, 1}, { 0, 1, 0}},
+    {{ 0, 1, 0}, { 1, 0, 0}, { 0, 0,-1}},
+    {{ 0,-1, 0}, { 1, 0, 0}, { 0, 0, 1}},
+    {{ 0, 0, 1}, { 1, 0, 0}, { 0, 1, 0}},
+    {{ 0, 0,-1}, {-1, 0, 0}, { 0, 1, 0}},
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+ShadowCubeMap::ShadowCubeMap(int size, float near, float far) :
+    size(size),
+    near(near),
+    far(far),
+    faces(6, DepthMap(size, size)),
+    static_faces(6, DepthMap(size, size))
+{
+    setLight(Vec3({0, 0, 0}));
+}
+
+void ShadowCubeMap::setLight(const Vec3 &pos)
+{
+    light_pos = pos;
+    Mat4 proj = tmath::perspective(3.14159265f / 2.0f, 1.0f, near, far);
+    for(int f = 0; f < 6; f++) {
+        // Rows right, up and -forward, as in Camera::view()
+        const float (*axes)[3] = FACE_AXES[f];
+        float rows[3][3];
+        for(int j = 0; j < 3; j++) {
+            rows[0][j] = axes[1][j];
+            rows[1][j] = axes[2][j];
+            rows[2][j] = -axes[0][j];
+        }
+        Mat4 view;
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 3; j++) view(i, j) = rows[i][j];
+            view(i, 3) = -(rows[i][0] * pos[0] + rows[i][1] * pos[1] + rows[i][2] * pos[2]);
+        }
+        view(3, 3) = 1.0f;
+        face_to_clip[f] = proj * view;
+    }
+}
+
+void ShadowCubeMap::drawCasters(const std::vector<ShadowCaster> &casters, bool is_static,
+                                std::vector<DepthMap> &target, ShadowStats &stats)
+{
+    for(int f = 0; f < 6; f++) {
+        Frustum frustum(face_to_clip[f]);
+        for(const ShadowCaster &caster : casters) {
+            if(caster.is_static != is_static) continue;
+
+            auto it = model_bounds.find(caster.model);
+            if(it == model_bounds.end()) {
+                it = model_bounds.emplace(caster.model, model_aabb(*caster.model)).first;
+            }
+            if(frustum.classify(it->second.transformed(caster.transform)) == Containment::Outside) {
+                stats.casters_culled++;
+                continue;
+            }
+            ArenaMark caster_scope;
+            stats.triangles += draw_depth(*caster.model, face_to_clip[f] * caster.transform,
+                                          target[f]);
+        }
+    }
+}
+
+ShadowStats ShadowCubeMap::update(const PointLight &light, const std::vector<ShadowCaster> &casters)
+{
+    ShadowStats stats;
+    Clock::time_point start = Clock::now();
+
+    if(!static_valid or tmath::length(light.pos - light_pos) > 0.0f) {
+        setLight(light.pos);
+        for(DepthMap &face : static_faces) face.Fill(1.0f);
+        drawCasters(casters, true, static_faces, stats);
+        static_valid = true;
+        stats.static_ms = ms_since(start);
+        start = Clock::now();
+    } else {
+        stats.cache_hit = true;
+    }
+
+    for(int f = 0; f < 6; f++) {
+        faces[f].CopyRect(static_faces[f], 0, 0, size, size);
+    }
+    drawCasters(casters, false, faces, stats);
+    stats.dynamic_ms = ms_since(start);
+    return stats;
+}
+
+float ShadowCubeMap::visibility(const Vec3 &pos, float bias, int pcf_radius) const
+{
+    float d[3] = { pos[0] - light_pos[0], pos[1] - light_pos[1], pos[2] - light_pos[2] };
+
+    // The face of the major axis, its forward component is the view depth
+    int axis = 0;
+    if(std::abs(d[1]) > std::abs(d[axis])) axis = 1;
+    if(std::abs(d[2]) > std::abs(d[axis])) axis = 2;
+    int f = axis * 2 + (d[axis] < 0.0f);
+    const float (*axes)[3] = FACE_AXES[f];
+    float depth = std::abs(d[axis]);
+    if(depth <= near) return 1.0f;
+    if(depth >= far) return 1.0f;
+
+    float u = (axes[1][0] * d[0] + axes[1][1] * d[1] + axes[1][2] * d[2]) / depth;
+    float v = (axes[2][0] * d[0] + axes[2][1] * d[1] + axes[2][2] * d[2]) / depth;
+    int cx = std::clamp(int((u + 1.0f) * 0.5f * size), 0, size - 1);
+    int cy = std::clamp(int((1.0f - v) * 0.5f * size), 0, size - 1);
+
+    // Compare in NDC, as stored, after moving the point towards the light
+    // by the bias and about one texel's footprint at its depth
+    float biased = std::max(depth - bias - 2.0f * depth / size, near);
+    float a = (far + near) / (far - near);
+    float b = 2.0f * far * near / (far - near);
+    float ndc = a - b / biased;
+
+    int r = std::clamp(pcf_radius, 0, SHADOW_PCF_MAX_RADIUS);
+    const float *data = faces[f].getRawData();
+    int lit = 0, taps = 0;
+    for(int y = std::max(cy - r, 0); y <= std::min(cy + r, size - 1); y++) {
+        for(int x = std::max(cx - r, 0); x <= std::min(cx + r, size - 1); x++) {
+            lit += ndc <= data[y * size + x];
+            taps++;
+        }
+    }
+    return float(lit) / taps;
+}
+
+float ShadowCubeMap::visibility(const Vec3 &pos, const Vec3 &normal, float bias,
+                                int pcf_radius) const
+{
+    // A texel covers 2 * depth / size at the depth of the face, the kernel
+    // reaches pcf_radius texels further on either side
+    Vec3 d = pos - light_pos;
+    float depth = std::max({std::abs(d[0]), std::abs(d[1]), std::abs(d[2])});
+    int r = std::clamp(pcf_radius, 0, SHADOW_PCF_MAX_RADIUS);
+    float offset = (r + 1) * 2.0f * depth / size;
+    return visibility(pos + normal * offset, bias, pcf_radius);
+}
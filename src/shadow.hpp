@@ -0,0 +1,111 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  shadow.hpp
+ *
+ *    Description:  Rasterized cube shadow maps for point lights
+ *
+ *        Version:  1.0
+ *        Created:  24.10.2026 14:20:51
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef SHADOW_HPP
+#define SHADOW_HPP
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+
+#include "model.hpp"
+#include "bounds.hpp"
+#include "lighting.hpp"
+#include "math/vector.hpp"
+#include "math/matrix.hpp"
+
+const int SHADOW_MAP_SIZE = 256;
+// PCF kernels are at most (2 * radius + 1)^2 taps
+const int SHADOW_PCF_MAX_RADIUS = 2;
+
+struct ShadowCaster
+{
+    const Model *model;
+    Mat4 transform;
+    // Drawn once into the cached layer, until the light moves or
+    // invalidateStatic() is called
+    bool is_static;
+};
+
+// Cost of one light's update
+struct ShadowStats
+{
+    double static_ms = 0.0;     // zero on a cache hit
+    double dynamic_ms = 0.0;    // restoring the cache and the dynamic casters
+    size_t triangles = 0;       // sent to the depth rasterizer
+    size_t casters_culled = 0;  // per face, outside of its frustum
+    bool cache_hit = false;
+
+    double totalMs() const { return static_ms + dynamic_ms; }
+};
+
+// Six depth maps around a point light, one per axis direction with a 90
+// degree frustum each. Depths are rendered without shaders through
+// draw_depth(). The static casters are kept in a separate layer that is
+// copied under the dynamic ones every update.
+class ShadowCubeMap
+{
+    int size;
+    float near, far;
+
+    std::vector<DepthMap> faces;
+    std::vector<DepthMap> static_faces;
+    std::array<Mat4, 6> face_to_clip;
+    Vec3 light_pos;
+    bool static_valid = false;
+
+    std::unordered_map<const Model*, AABB> model_bounds;
+
+    void setLight(const Vec3 &pos);
+    void drawCasters(const std::vector<ShadowCaster> &casters, bool is_static,
+                     std::vector<DepthMap> &target, ShadowStats &stats);
+
+public:
+    // Casters beyond `far` from the light cast no shadow
+    ShadowCubeMap(int size = SHADOW_MAP_SIZE, float near = 0.05f, float far = 100.0f);
+
+    ShadowStats update(const PointLight &light, const std::vector<ShadowCaster> &casters);
+
+    // The static layer is redrawn on the next update
+    void invalidateStatic() { static_valid = false; }
+
+    // Fraction of the light reaching `pos`, from a PCF kernel of
+    // `pcf_radius` texels around it (clamped to SHADOW_PCF_MAX_RADIUS).
+    // `bias` is in world units, a texel's footprint is added to it.
+    float visibility(const Vec3 &pos, float bias = 0.02f, int pcf_radius = 1) const;
+    // The same for a surface point with unit `normal`. The point is first
+    // moved off the surface by the kernel's footprint, which keeps
+    // surfaces at grazing angles to the light from shadowing themselves.
+    float visibility(const Vec3 &pos, const Vec3 &normal, float bias = 0.02f,
+                     int pcf_radius = 1) const;
+
+    const DepthMap& getFace(int face) const { return faces[face]; }
+    const Mat4& getFaceMatrix(int face) const { return face_to_clip[face]; }
+};
+
+// Deferred phong with the light occluded by `shadow`, updated for it
+template<typename FB>
+void phong(const PointLight &light, const ShadowCubeMap &shadow, const Vec3 &cam_pos,
+           FB &input, FB &output, int pcf_radius = 1)
+{
+    phong(light, cam_pos, input, output, [&](const Vec3 &pos, const Vec3 &normal) {
+        return shadow.visibility(pos, normal, 0.02f, pcf_radius);
+    });
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  texture.cpp
+ *
+ *    Description:  Mipmapped textures and samplers
+ *
+ *        Version:  1.0
+ *        Created:  25.10.2026 16:43:05
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "texture.hpp"
+
+Texture::Texture(const RGBAImage &image, bool mips)
+{
+    int w = image.getWidth(), h = image.getHeight();
+    levels.emplace_back(w, h);
+    Level &base = levels[0];
+    #pragma omp parallel for
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            base(y, x) = image.value_at(y, x);
+        }
+    }
+    if(mips) generateMips();
+}
+
+Texture::Texture(const ColorBuffer &image, bool mips)
+{
+    int w = image.getWidth(), h = image.getHeight();
+    levels.emplace_back(w, h);
+    Level &base = levels[0];
+    #pragma omp parallel
+    {
+        std::vector<float> row(w * 4);
+
+        #pragma omp for
+        for(int y = 0; y < h; y++) {
+            image.loadRow(y, row.data());
+            for(int x = 0; x < w; x++) {
+                base(y, x) = RGBAColor({row[x*4], row[x*4+1], row[x*4+2], row[x*4+3]});
+            }
+        }
+    }
+    if(mips) generateMips();
+}
+
+void Texture::generateMips()
+{
+    levels.erase(levels.begin() + 1, levels.end());
+    while(levels.back().getWidth() > 1 or levels.back().getHeight() > 1) {
+        const Level &src = levels.back();
+        int sw = src.getWidth(), sh = src.getHeight();
+        int w = std::max(sw / 2, 1), h = std::max(sh / 2, 1);
+        Level dst(w, h);
+
+        #pragma omp parallel for
+        for(int y = 0; y < h; y++) {
+            int y0 = std::min(2 * y, sh - 1), y1 = std::min(2 * y + 1, sh - 1);
+            for(int x = 0; x < w; x++) {
+                int x0 = std::min(2 * x, sw - 1), x1 = std::min(2 * x + 1, sw - 1);
+                RGBAColor a = src.value_at(y0, x0), b = src.value_at(y0, x1);
+                RGBAColor c = src.value_at(y1, x0), d = src.value_at(y1, x1);
+                RGBAColor &res = dst(y, x);
+                for(int ch = 0; ch < 4; ch++) {
+                    res[ch] = (a[ch] + b[ch] + c[ch] + d[ch]) * 0.25f;
+                }
+            }
+        }
+        levels.push_back(std::move(dst));
+    }
+}
+
+float Texture::lod(float dudx, float dvdx, float dudy, float dvdy) const
+{
+    float w = getWidth(), h = getHeight();
+    float x = (dudx * w) * (dudx * w) + (dvdx * h) * (dvdx * h);
+    float y = (dudy * w) * (dudy * w) + (dvdy * h) * (dvdy * h);
+    float rho2 = std::max(x, y);
+    // log2 of the square root
+    return rho2 > 0.0f ? 0.5f * std::log2(rho2) : 0.0f;
+}
+
+RGBAColor Texture::sample(float u, float v, float lod, const Sampler &sampler) const
+{
+    float max_level = levels.size() - 1;
+    lod = std::clamp(lod, 0.0f, max_level);
+    if(sampler.filter != Filter::Trilinear) {
+        int level = std::lround(lod);
+        return sampleLevel(level, u, v, sampler.filter, sampler.wrap);
+    }
+
+    int l0 = int(lod);
+    float t = lod - l0;
+    RGBAColor c0 = sampleLevel(l0, u, v, Filter::Bilinear, sampler.wrap);
+    if(t == 0.0f) return c0;
+    RGBAColor c1 = sampleLevel(l0 + 1, u, v, Filter::Bilinear, sampler.wrap);
+    RGBAColor res;
+    for(int c = 0; c < 4; c++) {
+        res[c] = c0[c] + (c1[c] - c0[c]) * t;
+    }
+    return res;
+}
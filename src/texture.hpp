@@ -0,0 +1,166 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  texture.hpp
+ *
+ *    Description:  Mipmapped textures and samplers
+ *
+ *        Version:  1.0
+ *        Created:  25.10.2026 16:43:05
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef TEXTURE_HPP
+#define TEXTURE_HPP
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "image.hpp"
+#include "color.hpp"
+
+enum class Filter
+{
+    Nearest,        // nearest texel of the nearest level
+    Bilinear,       // four texels of the nearest level
+    Trilinear       // bilinear in the two nearest levels, blended
+};
+
+enum class Wrap
+{
+    Repeat,
+    Clamp
+};
+
+struct Sampler
+{
+    Filter filter = Filter::Trilinear;
+    Wrap wrap = Wrap::Repeat;
+};
+
+// Texture coordinates: u goes along a row from the left, v down from the
+// top row, the image spans [0, 1] in both. Texel i covers [i, i + 1) / size.
+
+inline int wrap_texel(int i, int size, Wrap wrap)
+{
+    if(wrap == Wrap::Clamp) return std::clamp(i, 0, size - 1);
+    i %= size;
+    return i < 0 ? i + size : i;
+}
+
+// `fetch(x, y)` returns a texel of a width x height image
+template<typename Fetch>
+RGBAColor sample_nearest(const Fetch &fetch, int width, int height, float u, float v, Wrap wrap)
+{
+    int x = wrap_texel(int(std::floor(u * width)), width, wrap);
+    int y = wrap_texel(int(std::floor(v * height)), height, wrap);
+    return fetch(x, y);
+}
+
+template<typename Fetch>
+RGBAColor sample_bilinear(const Fetch &fetch, int width, int height, float u, float v, Wrap wrap)
+{
+    float x = u * width - 0.5f;
+    float y = v * height - 0.5f;
+    float fx = std::floor(x), fy = std::floor(y);
+    float tx = x - fx, ty = y - fy;
+    int x0 = wrap_texel(int(fx), width, wrap), x1 = wrap_texel(int(fx) + 1, width, wrap);
+    int y0 = wrap_texel(int(fy), height, wrap), y1 = wrap_texel(int(fy) + 1, height, wrap);
+
+    RGBAColor c00 = fetch(x0, y0), c10 = fetch(x1, y0);
+    RGBAColor c01 = fetch(x0, y1), c11 = fetch(x1, y1);
+    RGBAColor res;
+    for(int c = 0; c < 4; c++) {
+        float top = c00[c] + (c10[c] - c00[c]) * tx;
+        float bottom = c01[c] + (c11[c] - c01[c]) * tx;
+        res[c] = top + (bottom - top) * ty;
+    }
+    return res;
+}
+
+// Samples the colour of a render target (a Framebuffer or anything with
+// getPixel(x, y)) where it is, without copying it into a texture. There
+// are no mips, Trilinear filters like Bilinear.
+template<typename FB>
+RGBAColor sample_target(const FB &fb, float u, float v, Filter filter = Filter::Bilinear,
+                        Wrap wrap = Wrap::Clamp)
+{
+    auto fetch = [&fb](int x, int y) { return fb.getPixel(x, y); };
+    if(filter == Filter::Nearest) {
+        return sample_nearest(fetch, fb.getWidth(), fb.getHeight(), u, v, wrap);
+    }
+    return sample_bilinear(fetch, fb.getWidth(), fb.getHeight(), u, v, wrap);
+}
+
+// RGBA float texture with its mip chain down to 1x1. Levels use
+// TiledLayout, so the texels of a bilinear tap and of neighbouring
+// fragments mostly share a block.
+class Texture
+{
+public:
+    using Level = RenderBuffer<RGBAColor, 1, TiledLayout>;
+
+private:
+    std::vector<Level> levels;
+
+    RGBAColor sampleLevel(int level, float u, float v, Filter filter, Wrap wrap) const
+    {
+        const Level &img = levels[level];
+        auto fetch = [&img](int x, int y) { return img.value_at(y, x); };
+        if(filter == Filter::Nearest) {
+            return sample_nearest(fetch, img.getWidth(), img.getHeight(), u, v, wrap);
+        }
+        return sample_bilinear(fetch, img.getWidth(), img.getHeight(), u, v, wrap);
+    }
+
+public:
+    // Copies level 0 from `image`, and builds the mips unless told not to
+    Texture(const RGBAImage &image, bool mips = true);
+
+    // From the colour of a render target, e.g. fb.getImage()
+    Texture(const ColorBuffer &image, bool mips = true);
+
+    // Rebuilds every level from level 0 with a 2x2 box filter, for
+    // after writing to getLevel(0)
+    void generateMips();
+
+    int numLevels() const { return levels.size(); }
+    int getWidth() const { return levels[0].getWidth(); }
+    int getHeight() const { return levels[0].getHeight(); }
+    Level& getLevel(int level) { return levels[level]; }
+    const Level& getLevel(int level) const { return levels[level]; }
+
+    // Level of detail for the change of (u, v) per pixel along screen
+    // x and y: log2 of the larger footprint in texels
+    float lod(float dudx, float dvdx, float dudy, float dvdy) const;
+
+    RGBAColor sample(float u, float v, float lod = 0.0f, const Sampler &sampler = Sampler()) const;
+
+    // With the level of detail of the derivatives, see dFdx
+    RGBAColor sampleGrad(float u, float v, float dudx, float dvdx, float dudy, float dvdy,
+                         const Sampler &sampler = Sampler()) const
+    {
+        return sample(u, v, lod(dudx, dvdx, dudy, dvdy), sampler);
+    }
+};
+
+// Non-owning reference to a texture, to bind it as a uniform
+class TextureView
+{
+    const Texture *tex;
+public:
+    TextureView(const Texture &tex) : tex(&tex) { }
+
+    const Texture& get() const { return *tex; }
+    const Texture& operator*() const { return *tex; }
+    const Texture* operator->() const { return tex; }
+};
+
+#endif
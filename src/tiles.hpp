@@ -0,0 +1,180 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  tiles.hpp
+ *
+ *    Description:  Splitting of render buffers into square tiles with per-tile state
+ *
+ *        Version:  1.0
+ *        Created:  19.10.2026 16:40:05
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef TILES_HPP
+#define TILES_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+const int TILE_SHIFT = 6;
+const int TILE_SIZE = 1 << TILE_SHIFT;
+
+struct TileRect
+{
+    int x0, y0;
+    int x1, y1;  // exclusive
+};
+
+class TileGrid
+{
+    int width, height;
+    int tiles_x, tiles_y;
+public:
+    TileGrid(int width, int height) :
+        width(width), height(height),
+        tiles_x((width + TILE_SIZE - 1) >> TILE_SHIFT),
+        tiles_y((height + TILE_SIZE - 1) >> TILE_SHIFT)
+    { }
+
+    int getTilesX() const { return tiles_x; }
+    int getTilesY() const { return tiles_y; }
+    int numTiles() const { return tiles_x * tiles_y; }
+
+    int tileAt(int y, int x) const
+    {
+        return (y >> TILE_SHIFT) * tiles_x + (x >> TILE_SHIFT);
+    }
+
+    TileRect rect(int tile) const
+    {
+        int tx = tile % tiles_x;
+        int ty = tile / tiles_x;
+        return TileRect({
+                tx * TILE_SIZE, ty * TILE_SIZE,
+                std::min((tx + 1) * TILE_SIZE, width),
+                std::min((ty + 1) * TILE_SIZE, height)
+                });
+    }
+
+    // Pixel rectangles covering every tile for which `is_set(tile)` holds.
+    // Runs of tiles in a row are joined, then runs with the same span in
+    // consecutive rows, so a changed block comes back as one rectangle.
+    template<typename Pred>
+    std::vector<TileRect> mergeRects(Pred is_set) const
+    {
+        std::vector<TileRect> rects;     // in tiles until the end
+        std::vector<size_t> open, next;  // runs that reached the previous row
+        for(int ty = 0; ty < tiles_y; ty++) {
+            next.clear();
+            size_t k = 0;
+            for(int tx = 0; tx < tiles_x; tx++) {
+                if(!is_set(ty * tiles_x + tx)) continue;
+                int start = tx;
+                while(tx + 1 < tiles_x and is_set(ty * tiles_x + tx + 1)) tx++;
+
+                while(k < open.size() and rects[open[k]].x0 < start) k++;
+                if(k < open.size() and rects[open[k]].x0 == start
+                        and rects[open[k]].x1 == tx + 1) {
+                    rects[open[k]].y1 = ty + 1;
+                    next.push_back(open[k]);
+                } else {
+                    next.push_back(rects.size());
+                    rects.push_back(TileRect({start, ty, tx + 1, ty + 1}));
+                }
+            }
+            std::swap(open, next);
+        }
+
+        for(auto &r : rects) {
+            r = TileRect({
+                    r.x0 * TILE_SIZE, r.y0 * TILE_SIZE,
+                    std::min(r.x1 * TILE_SIZE, width),
+                    std::min(r.y1 * TILE_SIZE, height)
+                    });
+        }
+        return rects;
+    }
+};
+
+// A set of flag bits per tile that can be read and updated from many
+// threads. Bit 7 is reserved as a lock for whoever acts on the flags.
+class TileFlags
+{
+    int count;
+    std::unique_ptr<std::atomic<uint8_t>[]> flags;
+public:
+    static const uint8_t BUSY = 0x80;
+
+    TileFlags(int count) :
+        count(count),
+        flags(new std::atomic<uint8_t>[count])
+    {
+        clear();
+    }
+
+    TileFlags(const TileFlags &other) : TileFlags(other.count)
+    {
+        for(int i = 0; i < count; i++) {
+            flags[i].store(other.get(i) & ~BUSY, std::memory_order_relaxed);
+        }
+    }
+
+    int size() const { return count; }
+
+    uint8_t get(int tile) const
+    {
+        return flags[tile].load(std::memory_order_acquire);
+    }
+
+    void set(int tile, uint8_t bits)
+    {
+        flags[tile].fetch_or(bits, std::memory_order_acq_rel);
+    }
+
+    void setAll(uint8_t bits)
+    {
+        for(int i = 0; i < count; i++) {
+            flags[i].fetch_or(bits, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void clear()
+    {
+        for(int i = 0; i < count; i++) {
+            flags[i].store(0, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    // Runs `func(bits)` once for a tile with any flag set and then resets the
+    // flags. Threads that race for the same tile wait until it is done.
+    template<typename Func>
+    void consume(int tile, Func func)
+    {
+        auto &f = flags[tile];
+        uint8_t bits = f.load(std::memory_order_acquire);
+        while(bits) {
+            if(bits & BUSY) {
+                bits = f.load(std::memory_order_acquire);
+                continue;
+            }
+            if(f.compare_exchange_weak(bits, bits | BUSY, std::memory_order_acq_rel)) {
+                func(bits);
+                f.store(0, std::memory_order_release);
+                return;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  visbuffer.cpp
+ *
+ *    Description:  Visibility buffer: rasterize ids, shade each pixel once
+ *
+ *        Version:  1.0
+ *        Created:  25.10.2026 11:07:18
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#include "visbuffer.hpp"
+
+#include <limits>
+#include <iostream>
+
+#include "rasterizer.hpp"
+
+static const float FAR_DEPTH = std::numeric_limits<float>::max();
+
+VisibilityBuffer::VisibilityBuffer(int width, int height) :
+    width(width),
+    height(height),
+    depth(width, height),
+    ids(width, height)
+{
+    clear();
+}
+
+void VisibilityBuffer::clear()
+{
+    depth.Fill(FAR_DEPTH);
+    ids.Fill(VISBUFFER_EMPTY);
+    draws.clear();
+}
+
+int VisibilityBuffer::draw(const Model &model, Shader shader, const UniformVec &uni)
+{
+    if(int(draws.size()) >= VISBUFFER_MAX_DRAWS) {
+        std::cout << "Visibility buffer is out of draw ids" << std::endl;
+        return -1;
+    }
+    const IndexBuffer &ib = model.indices;
+    // The last id of the last draw would pack to VISBUFFER_EMPTY
+    if(ib.numTriangles() >= (size_t(1) << VISBUFFER_TRIANGLE_BITS)) {
+        std::cout << "Model has too many triangles for the visibility buffer" << std::endl;
+        return -1;
+    }
+
+    uint32_t draw_id = draws.size();
+    draws.push_back({&model, apply_fsh_uniform(shader.frag, uni), {}, {}, 0});
+    Draw &d = draws.back();
+
+    PartialVSH vsh = apply_vsh_uniform(shader.vert, uni);
+    const VertexBuffer &vb = model.vertices;
+    d.screen.resize(vb.size());
+    AttribVec attrs;
+    for(size_t i = 0; i < vb.size(); i++) {
+        vb.decode(i, attrs);
+        Vertex v = vsh(attrs);
+        if(i == 0) {
+            d.num_varyings = v.attr.size();
+            d.varyings.resize(vb.size() * d.num_varyings);
+        }
+        d.screen[i] = Vec3({(v.position[0] + 1.0f) * 0.5f * width,
+                            (1.0f - v.position[1]) * 0.5f * height,
+                            v.position[2]});
+        std::copy(v.attr.begin(), v.attr.end(), d.varyings.begin() + i * d.num_varyings);
+    }
+
+    float *z_data = depth.getRawData();
+    uint32_t *id_data = ids.getRawData();
+    int w = width;
+    for(size_t t = 0; t < ib.numTriangles(); t++) {
+        uint32_t id = pack_visibility(draw_id, t);
+        scan_triangle(d.screen[ib[3*t]], d.screen[ib[3*t+1]], d.screen[ib[3*t+2]],
+                      width, height, [=](int x, int y, float z) {
+            if(z < -1.0f or z > 1.0f) return;
+            size_t i = size_t(y) * w + x;
+            if(z < z_data[i]) {
+                z_data[i] = z;
+                id_data[i] = id;
+            }
+        });
+    }
+    return draw_id;
+}
+
+size_t VisibilityBuffer::resolve(Framebuffer &fbo) const
+{
+    if(fbo.getWidth() != width or fbo.getHeight() != height) {
+        std::cout << "Visibility buffer and framebuffer sizes differ" << std::endl;
+        return 0;
+    }
+
+    const TileGrid &tiles = fbo.getTiles();
+    size_t shaded = 0;
+
+    #pragma omp parallel reduction(+:shaded)
+    {
+        // Interpolated varyings live for one pixel
+        FrameArena arena(64 << 10);
+        ArenaScope thread_scope(&arena);
+
+        #pragma omp for schedule(dynamic)
+        for(int tile = 0; tile < tiles.numTiles(); tile++) {
+            TileRect rect = tiles.rect(tile);
+            for(int y = rect.y0; y < rect.y1; y++) {
+                for(int x = rect.x0; x < rect.x1; x++) {
+                    uint32_t id = ids.value_at(y, x);
+                    if(id == VISBUFFER_EMPTY) continue;
+                    // Earlier draws into fbo can still hide the pixel
+                    float z = depth.value_at(y, x);
+                    if(!fbo.checkDepth(y, x, z)) continue;
+
+                    const Draw &d = draws[id >> VISBUFFER_TRIANGLE_BITS];
+                    size_t t = id & ((1u << VISBUFFER_TRIANGLE_BITS) - 1);
+                    const IndexBuffer &ib = d.model->indices;
+                    uint32_t v[3] = { ib[3*t], ib[3*t+1], ib[3*t+2] };
+                    const Vec3 &a = d.screen[v[0]];
+                    const Vec3 &b = d.screen[v[1]];
+                    const Vec3 &c = d.screen[v[2]];
+
+                    // Barycentrics of the pixel centre
+                    float px = x + 0.5f, py = y + 0.5f;
+                    float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+                    float w0 = ((c[0] - b[0]) * (py - b[1]) - (c[1] - b[1]) * (px - b[0])) / area;
+                    float w1 = ((a[0] - c[0]) * (py - c[1]) - (a[1] - c[1]) * (px - c[0])) / area;
+                    float w2 = 1.0f - w0 - w1;
+
+                    const Attribute *varyings = d.varyings.data();
+                    FragmentContext ctx = {
+                        { &a, &b, &c },
+                        { varyings + v[0] * d.num_varyings, varyings + v[1] * d.num_varyings,
+                          varyings + v[2] * d.num_varyings },
+                        d.num_varyings
+                    };
+                    FragmentScope fragment_scope(&ctx);
+
+                    ArenaMark pixel_scope;
+                    AttribVec attr(d.num_varyings);
+                    for(size_t i = 0; i < d.num_varyings; i++) {
+                        attr[i] = barycentric_attr(d.varyings[v[0] * d.num_varyings + i],
+                                                   d.varyings[v[1] * d.num_varyings + i],
+                                                   d.varyings[v[2] * d.num_varyings + i],
+                                                   w0, w1, w2);
+                    }
+
+                    if(fbo.depthEnabled()) fbo.putDepth(x, y, z);
+                    fbo.putStencil(x, y, 1);
+                    fbo.putColor(x, y, d.fsh(attr));
+                    if(fbo.varyingAttribsEnabled() and d.num_varyings >= 2) {
+                        fbo.putAttrib(x, y, FragAttrib({ std::get<Vec3>(attr[0]),
+                                                         tmath::normalize(std::get<Vec3>(attr[1])) }));
+                    }
+                    shaded++;
+                }
+            }
+        }
+    }
+    fbo.countFragment(shaded);
+    return shaded;
+}
@@ -0,0 +1,83 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  visbuffer.hpp
+ *
+ *    Description:  Visibility buffer: rasterize ids, shade each pixel once
+ *
+ *        Version:  1.0
+ *        Created:  25.10.2026 11:07:18
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Fedor Novikov (rstar000)
+ *   Organization:
+ *
+ * =====================================================================================
+ */
+
+#ifndef VISBUFFER_HPP
+#define VISBUFFER_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include "model.hpp"
+#include "shader.hpp"
+#include "framebuffer.hpp"
+
+// A pixel's id is the draw in the high bits and the triangle in the low
+const int VISBUFFER_TRIANGLE_BITS = 22;
+const int VISBUFFER_MAX_DRAWS = 1 << (32 - VISBUFFER_TRIANGLE_BITS);
+const uint32_t VISBUFFER_EMPTY = 0xffffffff;
+
+inline uint32_t pack_visibility(uint32_t draw, uint32_t triangle)
+{
+    return (draw << VISBUFFER_TRIANGLE_BITS) | triangle;
+}
+
+// Draws only rasterize depth and the id of the nearest triangle. Their
+// vertex shader outputs are kept, and resolve() interpolates them at
+// each covered pixel and runs the fragment shader once there, in
+// parallel over tiles. Interpolation is linear in screen space, as in
+// rasterize_triangle, so both give the same image.
+class VisibilityBuffer
+{
+    struct Draw
+    {
+        const Model *model;
+        PartialFSH fsh;
+        std::vector<Vec3> screen;           // per vertex, z is NDC depth
+        std::vector<Attribute> varyings;    // num_varyings per vertex
+        size_t num_varyings;
+    };
+
+    int width, height;
+    DepthMap depth;
+    RenderBuffer<uint32_t, 1> ids;
+    std::vector<Draw> draws;
+
+public:
+    VisibilityBuffer(int width, int height);
+
+    // Clears depth and ids and forgets the draws
+    void clear();
+
+    // Runs the vertex shader and rasterizes the model. The model must
+    // live until resolve(). Returns the draw index, -1 past
+    // VISBUFFER_MAX_DRAWS or with 2^VISBUFFER_TRIANGLE_BITS triangles.
+    int draw(const Model &model, Shader shader, const UniformVec &uni);
+
+    // Shades the covered pixels into `fbo` (same size) like an opaque
+    // draw would: depth tested against `fbo` if it has depth testing on,
+    // then depth, stencil and colour, and attributes if the framebuffer
+    // stores varyings. Returns the number of pixels shaded.
+    size_t resolve(Framebuffer &fbo) const;
+
+    const DepthMap& getDepth() const { return depth; }
+    const RenderBuffer<uint32_t, 1>& getIds() const { return ids; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
+
+#endif
@@ -0,0 +1,78 @@
+// Times the full-screen passes on row major and block linear buffers
+#include <chrono>
+#include <iostream>
+
+#include "ray_marching.hpp"
+#include "lighting.hpp"
+
+float spheres(Vec3 z)
+{
+    z[0] = std::fmod(std::fabs(z[0]) + 0.3f, 0.6f) - 0.3f;
+    z[2] = std::fmod(std::fabs(z[2]) + 0.3f, 0.6f) - 0.3f;
+    return length(z) - 0.1f;
+}
+
+MaybeResult trace_spheres(const Vec3 &origin, const Vec3 &direction)
+{
+    float d = 0.0f;
+    for(int i = 0; i < 40; i++) {
+        Vec3 pos = origin + d * direction;
+        float dist = spheres(pos);
+        if(dist < 0.001f) {
+            Vec3 normal = sdf_normal(spheres, pos);
+            return TraceResult({toVec4(abs(normal), 1.0f), normal, d});
+        }
+        d += dist;
+    }
+    return std::nullopt;
+}
+
+template<typename F>
+double time_ms(F f, int repeats = 3)
+{
+    double best = 1e30;
+    for(int i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+template<typename FB>
+void bench(const std::string &name, int w, int h)
+{
+    FB fb(w, h);
+    FB out(w, h);
+    Vec3 cam_pos({0.0f, 1.0f, -3.0f});
+    Quat cam_dir = look_at(cam_pos, Vec3({0,0,0}));
+    PointLight light;
+    light.pos = cam_pos;
+    light.strength = 45;
+
+    double t_trace = time_ms([&]() {
+        fb.clearAll(RGBAColor({0,0,0,1}));
+        trace(fb, trace_spheres, 3.1415f / 4, cam_pos, cam_dir);
+    });
+
+    double t_phong = time_ms([&]() {
+        out.clearAll(RGBAColor({0,0,0,1}));
+        phong(light, cam_pos, fb, out);
+    });
+
+    std::vector<float> linear(size_t(w) * h);
+    auto &depth = fb.getDepth();
+    double t_linear = time_ms([&]() { depth.linearize(linear.data()); });
+
+    std::cout << name << ": trace " << t_trace << " ms, phong " << t_phong
+              << " ms, depth linearize " << t_linear << " ms\n";
+}
+
+int main()
+{
+    int w = 960, h = 540;
+    bench<Framebuffer>("linear", w, h);
+    bench<TiledFramebuffer>("tiled ", w, h);
+    return 0;
+}